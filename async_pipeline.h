@@ -0,0 +1,234 @@
+/*
+ * File Name: async_pipeline.h
+ *
+ * Description:
+ * Threads that overlap I/O with the CPU stages: a reader thread fills a small ring of chunk
+ * buffers ahead of the tokenizer (ChunkReader), and OutputWriter::startBackgroundWrites hands
+ * full output buffers to a writer thread while formatting goes on in a spare buffer.
+ *
+ * The stages are connected by BoundedQueues, so a fast stage blocks once it is the queue depth
+ * ahead of a slow one (backpressure) and memory stays at depth × chunk size. Buffers travel in
+ * a loop between a "filled" and a "free" queue and are reused, so nothing is allocated per chunk.
+ *
+ * The reader uses plain blocking fread on its own thread, which works for files, pipes and
+ * network mounts on every platform; kernel submission queues such as io_uring would only replace
+ * the reader thread's fread calls.
+ */
+
+#ifndef ASYNC_PIPELINE_H
+#define ASYNC_PIPELINE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Blocking FIFO queue with a fixed capacity
+// push() waits while the queue is full and pop() while it is empty; after close() push() fails
+// and pop() returns the remaining items and then fails
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+    bool push(T item) {
+        std::unique_lock<std::mutex> guard(lock);
+        notFull.wait(guard, [this] { return items.size() < capacity || closed; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> guard(lock);
+        notEmpty.wait(guard, [this] { return !items.empty() || closed; });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> guard(lock);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+private:
+    std::mutex lock;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+};
+
+// A buffer and the number of bytes in use
+struct IoBlock {
+    std::vector<char> bytes;
+    size_t length = 0;
+};
+
+// Reads a file in fixed-size chunks on a reader thread, up to `depth` chunks ahead of next()
+class ChunkReader {
+public:
+    ChunkReader(FILE *file, size_t chunkSize, size_t depth = 3)
+        : file(file), chunkSize(chunkSize), filled(depth), spare(depth + 1) {
+        for (size_t i = 0; i < depth; ++i) {
+            spare.push(IoBlock());
+        }
+        reader = std::thread([this] { run(); });
+    }
+
+    ChunkReader(const ChunkReader &) = delete;
+    ChunkReader &operator=(const ChunkReader &) = delete;
+
+    ~ChunkReader() { stop(); }
+
+    // Stops the reader and waits for it, even if the file was not read to the end; it finishes
+    // the fread it is in first
+    void stop() {
+        filled.close();
+        spare.close();
+        if (reader.joinable()) {
+            reader.join();
+        }
+    }
+
+    // Returns the next chunk, valid until the following call; false at the end of the file
+    bool next(std::string_view &chunk) {
+        if (!current.bytes.empty()) {
+            spare.push(std::move(current)); // Recycle the previous chunk
+            current = IoBlock();
+        }
+        if (!filled.pop(current)) {
+            return false;
+        }
+        chunk = std::string_view(current.bytes.data(), current.length);
+        return true;
+    }
+
+    // True if reading stopped on an error rather than at the end of the file
+    // Only valid once the reader is done: after next() fails or after stop()
+    bool failed() const { return readFailed; }
+
+private:
+    void run() {
+        IoBlock block;
+        while (spare.pop(block)) {
+            block.bytes.resize(chunkSize);
+            block.length = fread(block.bytes.data(), 1, chunkSize, file);
+            if (block.length == 0) {
+                break;
+            }
+            bool last = block.length < chunkSize; // fread only comes back short at the end or on an error
+            if (!filled.push(std::move(block)) || last) {
+                break;
+            }
+        }
+        readFailed = ferror(file) != 0;
+        filled.close();
+    }
+
+    FILE *file;
+    size_t chunkSize;
+    BoundedQueue<IoBlock> filled; // Chunks read ahead, in file order
+    BoundedQueue<IoBlock> spare;  // Buffers the reader can fill next
+    IoBlock current;              // Chunk handed out by the last next()
+    bool readFailed = false;      // Written by the reader before it closes `filled`
+    std::thread reader;
+};
+
+// Appends everything left in the file to `content`, reading ahead on a reader thread
+// Returns false on a read error
+inline bool readWholeFile(FILE *file, std::string &content, size_t chunkSize = 1 << 20) {
+    ChunkReader reader(file, chunkSize);
+    std::string_view chunk;
+    while (reader.next(chunk)) {
+        content.append(chunk.data(), chunk.size());
+    }
+    return !reader.failed();
+}
+
+// Writer thread that writes filled buffers to a file in order (OutputWriter::startBackgroundWrites)
+class BlockWriterThread {
+public:
+    BlockWriterThread(FILE *file, size_t depth) : file(file), filled(depth), spare(depth + 1) {
+        for (size_t i = 0; i < depth; ++i) {
+            spare.push(IoBlock());
+        }
+        writer = std::thread([this] { run(); });
+    }
+
+    BlockWriterThread(const BlockWriterThread &) = delete;
+    BlockWriterThread &operator=(const BlockWriterThread &) = delete;
+
+    // Writes every queued block, then stops the writer
+    ~BlockWriterThread() {
+        filled.close();
+        writer.join();
+        spare.close();
+    }
+
+    // Queues the first `length` bytes of `buffer` and swaps in a spare buffer of the same size
+    // Blocks while `depth` blocks are already queued
+    void submit(std::vector<char> &buffer, size_t length) {
+        IoBlock block;
+        spare.pop(block);
+        block.bytes.resize(buffer.size());
+        block.bytes.swap(buffer);
+        block.length = length;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            ++submittedCount;
+        }
+        filled.push(std::move(block));
+    }
+
+    // Waits until every submitted block has been written; returns false if a write failed
+    bool drain() {
+        std::unique_lock<std::mutex> guard(lock);
+        allWritten.wait(guard, [this] { return writtenCount == submittedCount; });
+        return !writeFailed;
+    }
+
+private:
+    void run() {
+        IoBlock block;
+        while (filled.pop(block)) {
+            bool written = fwrite(block.bytes.data(), 1, block.length, file) == block.length;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                writeFailed = writeFailed || !written;
+                ++writtenCount;
+                allWritten.notify_all();
+            }
+            spare.push(std::move(block));
+        }
+    }
+
+    FILE *file;
+    BoundedQueue<IoBlock> filled; // Blocks waiting to be written, in order
+    BoundedQueue<IoBlock> spare;  // Written buffers ready for reuse
+    std::mutex lock;
+    std::condition_variable allWritten;
+    size_t submittedCount = 0;
+    size_t writtenCount = 0;
+    bool writeFailed = false;
+    std::thread writer;
+};
+
+#endif // ASYNC_PIPELINE_H
@@ -0,0 +1,243 @@
+/*
+ * File Name: decode_kernel.h
+ *
+ * Description:
+ * Block decoder that turns runs of positions back into text at close to memory speed. It is
+ * used for the plain varint position streams of binary containers and for in-memory position
+ * arrays (text_codec.h); Huffman-coded and escaped streams keep the per-token decoder.
+ *
+ * The dictionary is stored as one concatenated byte blob in which every token is followed by
+ * its separating space, plus an offset table, so the text of a token is one contiguous copy
+ * with no per-token string objects. Positions are handled DECODE_BLOCK_SIZE at a time:
+ *   1. Varints are unpacked into a block; when the block cannot run past the end of the input
+ *      the unpacking loop skips all per-byte bounds checks.
+ *   2. The whole block is range-checked with a branch-free OR, and the exact invalid position is
+ *      only searched for when the check fails.
+ *   3. The output is grown once for the block and each token is copied with a fixed 16-byte move
+ *      (longer tokens with memcpy); both the blob and the output keep TOKEN_COPY_SLACK spare
+ *      bytes so the fixed move never leaves their memory.
+ */
+
+#ifndef DECODE_KERNEL_H
+#define DECODE_KERNEL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Positions unpacked, checked and copied per block
+const size_t DECODE_BLOCK_SIZE = 512;
+
+// Spare bytes after the blob and the output, so short tokens are copied with one 16-byte move
+const size_t TOKEN_COPY_SLACK = 16;
+
+// A varint of a 64-bit value takes at most this many bytes
+const size_t MAX_VARINT_BYTES = 10;
+
+// Grows the output so `required` bytes fit, at least doubling it like push_back would
+inline void growOutput(std::string &text, size_t required) {
+    if (text.size() < required) {
+        text.resize(std::max(required, text.size() * 2));
+    }
+}
+
+// Dictionary stored as "token token token " in one buffer, with the start of every entry
+class TokenBlob {
+public:
+    // Copies the tokens (in sorted order, position p is tokens[p - 1]) into the blob
+    void assign(const std::vector<std::string_view> &tokens) {
+        size_t totalBytes = 0;
+        for (std::string_view token : tokens) {
+            totalBytes += token.size() + 1;
+        }
+        bytes.resize(totalBytes + TOKEN_COPY_SLACK);
+        offsets.resize(tokens.size() + 1);
+        size_t offset = 0;
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            offsets[i] = offset;
+            memcpy(&bytes[offset], tokens[i].data(), tokens[i].size());
+            offset += tokens[i].size();
+            bytes[offset++] = ' ';
+        }
+        offsets[tokens.size()] = offset;
+    }
+
+    size_t size() const { return offsets.size() - 1; }
+
+    // Token at 0-based rank `index`
+    std::string_view token(size_t index) const {
+        return std::string_view(bytes.data() + offsets[index], offsets[index + 1] - offsets[index] - 1);
+    }
+
+    // Returns the index of the first position outside 1..size(), or `count` if all are valid
+    template <typename Position>
+    size_t findInvalid(const Position *positions, size_t count) const {
+        uint64_t limit = size();
+        bool invalid = false;
+        for (size_t i = 0; i < count; ++i) {
+            invalid |= (uint64_t)((int64_t)positions[i] - 1) >= limit; // 0 and negative values wrap
+        }
+        if (!invalid) {
+            return count;
+        }
+        size_t i = 0;
+        while ((uint64_t)((int64_t)positions[i] - 1) < limit) {
+            ++i;
+        }
+        return i;
+    }
+
+    // Appends the entry ("token ") of every position to text[used..) and advances `used`
+    // The positions must be valid; `text` is grown as needed and may be longer than `used`
+    template <typename Position>
+    void appendEntries(const Position *positions, size_t count, std::string &text, size_t &used) const {
+        size_t needed = TOKEN_COPY_SLACK;
+        for (size_t i = 0; i < count; ++i) {
+            needed += offsets[positions[i]] - offsets[positions[i] - 1];
+        }
+        growOutput(text, used + needed);
+        char *output = &text[0];
+        const char *blob = bytes.data();
+        for (size_t i = 0; i < count; ++i) {
+            size_t start = offsets[positions[i] - 1];
+            size_t length = offsets[positions[i]] - start;
+            if (length <= TOKEN_COPY_SLACK) {
+                memcpy(output + used, blob + start, TOKEN_COPY_SLACK);
+            } else {
+                memcpy(output + used, blob + start, length);
+            }
+            used += length;
+        }
+    }
+
+    // Bytes of the entry of a valid position (the token and its space)
+    size_t entrySize(uint64_t position) const { return offsets[position] - offsets[position - 1]; }
+
+    // Writes the token of a valid position, without its space, to output[used..)
+    // The output must have room for the entry plus TOKEN_COPY_SLACK bytes
+    void copyToken(uint64_t position, char *output, size_t &used) const {
+        size_t start = offsets[position - 1];
+        size_t length = offsets[position] - start - 1;
+        if (length <= TOKEN_COPY_SLACK) {
+            memcpy(output + used, bytes.data() + start, TOKEN_COPY_SLACK);
+        } else {
+            memcpy(output + used, bytes.data() + start, length);
+        }
+        used += length;
+    }
+
+private:
+    std::string bytes;              // Every token followed by a space, then the slack
+    std::vector<size_t> offsets{0}; // Start of entry i; offsets[size()] is the end of the last
+};
+
+// Unpacks up to `count` varints from data[offset, end) into `values` and advances `offset`
+// Returns how many were unpacked; fewer than `count` means the input ended or is corrupt
+inline size_t unpackVarints(const uint8_t *data, size_t end, size_t &offset, uint64_t *values, size_t count) {
+    if (end - offset >= count * MAX_VARINT_BYTES) { // The block cannot run past the end
+        const uint8_t *input = data + offset;
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t value = *input++;
+            if (value >= 0x80) {
+                value &= 0x7F;
+                int shift = 7;
+                uint8_t byte;
+                do {
+                    if (shift >= 64) {
+                        offset = (size_t)(input - data);
+                        return i; // More than 10 bytes is not a valid 64-bit varint
+                    }
+                    byte = *input++;
+                    value |= (uint64_t)(byte & 0x7F) << shift;
+                    shift += 7;
+                } while (byte & 0x80);
+            }
+            values[i] = value;
+        }
+        offset = (size_t)(input - data);
+        return count;
+    }
+    for (size_t i = 0; i < count; ++i) { // Near the end: check every byte
+        uint64_t value = 0;
+        bool complete = false;
+        for (int shift = 0; shift < 64 && offset < end; shift += 7) {
+            uint8_t byte = data[offset++];
+            value |= (uint64_t)(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                complete = true;
+                break;
+            }
+        }
+        if (!complete) {
+            return i;
+        }
+        values[i] = value;
+    }
+    return count;
+}
+
+// Decodes `skip + take` varint positions from bytes[offset, end) and appends the last `take`
+// tokens to `text`, separated by single spaces; `offset` is left after the last position read
+inline bool decodeVarintBlocks(std::string_view bytes, size_t &offset, size_t end, const TokenBlob &blob,
+                               uint64_t skip, uint64_t take, std::string &text, std::string &errorMessage) {
+    const uint8_t *data = (const uint8_t *)bytes.data();
+    size_t used = text.size();
+    uint64_t values[DECODE_BLOCK_SIZE];
+    for (uint64_t done = 0; done < skip + take;) {
+        size_t count = (size_t)std::min<uint64_t>(DECODE_BLOCK_SIZE, skip + take - done);
+        size_t unpacked = unpackVarints(data, end, offset, values, count);
+        size_t invalid = blob.findInvalid(values, unpacked);
+        if (invalid < unpacked) {
+            text.resize(used);
+            errorMessage = "Invalid position " + std::to_string(values[invalid]);
+            return false;
+        }
+        if (unpacked < count) {
+            text.resize(used);
+            errorMessage = "Truncated or corrupt position stream.";
+            return false;
+        }
+        size_t first = done < skip ? (size_t)std::min<uint64_t>(count, skip - done) : 0; // Skipped positions
+        blob.appendEntries(values + first, count - first, text, used);
+        done += count;
+    }
+    if (take > 0) {
+        --used; // No space after the last token
+    }
+    text.resize(used);
+    return true;
+}
+
+// Decodes `skip + take` varint positions from bytes[start, end) and appends the last `take`
+// tokens to `text`, separated by single spaces
+inline bool decodeVarintRun(std::string_view bytes, size_t start, size_t end, const TokenBlob &blob, uint64_t skip,
+                            uint64_t take, std::string &text, std::string &errorMessage) {
+    return decodeVarintBlocks(bytes, start, end, blob, skip, take, text, errorMessage);
+}
+
+// Appends the tokens at `positions` to `text`, separated by single spaces
+inline bool decodePositionArray(const int *positions, size_t count, const TokenBlob &blob, std::string &text,
+                                std::string &errorMessage) {
+    size_t used = text.size();
+    for (size_t done = 0; done < count; done += DECODE_BLOCK_SIZE) {
+        size_t blockSize = std::min(DECODE_BLOCK_SIZE, count - done);
+        size_t invalid = blob.findInvalid(positions + done, blockSize);
+        if (invalid < blockSize) {
+            text.resize(used);
+            errorMessage = "Invalid position " + std::to_string(positions[done + invalid]);
+            return false;
+        }
+        blob.appendEntries(positions + done, blockSize, text, used);
+    }
+    if (count > 0) {
+        --used; // No space after the last token
+    }
+    text.resize(used);
+    return true;
+}
+
+#endif // DECODE_KERNEL_H
@@ -0,0 +1,169 @@
+/*
+ * File Name: dictionary_file.h
+ *
+ * Description:
+ * Persistent token ranking written by `project5 --dict-out` and loaded by `--dict-in`. A saved
+ * dictionary lets the encoder skip the frequency and sort steps: every token is looked up in
+ * the saved ranking, and tokens that are missing from it are written as an escape (position 0)
+ * followed by the literal token.
+ *
+ * The file is laid out for memory mapping: fixed 8-byte little-endian fields, so it is used
+ * in place without being parsed or copied.
+ *
+ *   magic          4 bytes "P5DC"
+ *   version        4 bytes (DICTIONARY_VERSION)
+ *   tokenCount     number of tokens, in sorted order
+ *   fingerprint    hash of the token list; encoded output records it so that the decoder can
+ *                  check it was given the same dictionary
+ *   blobBytes      size of the token byte blob
+ *   offsets        tokenCount + 1 offsets into the blob (token r is [offsets[r], offsets[r+1]))
+ *   counts         tokenCount frequencies from the run that produced the dictionary
+ *   blob           the token bytes, back to back
+ */
+
+#ifndef DICTIONARY_FILE_H
+#define DICTIONARY_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "encoded_format.h"
+#include "flat_token_map.h"
+#include "mapped_file.h"
+#include "output_writer.h"
+
+inline constexpr char DICTIONARY_MAGIC[4] = {'P', '5', 'D', 'C'};
+const uint32_t DICTIONARY_VERSION = 1;
+const size_t DICTIONARY_HEADER_SIZE = 32;
+
+// Order-sensitive hash of a token list
+template <typename TokenList>
+uint64_t dictionaryFingerprint(const TokenList &tokens) {
+    uint64_t fingerprint = tokens.size();
+    for (std::string_view token : tokens) {
+        fingerprint = (fingerprint ^ hashToken(token)) * 0x9E3779B97F4A7C15ull;
+    }
+    return fingerprint;
+}
+
+// Writes the tokens (in sorted order) and their counts as a dictionary file
+template <typename TokenList>
+bool writeDictionaryFile(const std::string &path, const TokenList &tokens, const std::vector<uint64_t> &counts,
+                         std::string &errorMessage) {
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        errorMessage = "Could not create '" + path + "'.";
+        return false;
+    }
+    uint64_t blobBytes = 0;
+    for (std::string_view token : tokens) {
+        blobBytes += token.size();
+    }
+    {
+        OutputWriter writer(file);
+        writer.write(std::string_view(DICTIONARY_MAGIC, sizeof(DICTIONARY_MAGIC)));
+        writer.writeUint32(DICTIONARY_VERSION);
+        writer.writeUint64(tokens.size());
+        writer.writeUint64(dictionaryFingerprint(tokens));
+        writer.writeUint64(blobBytes);
+        uint64_t offset = 0;
+        writer.writeUint64(offset);
+        for (std::string_view token : tokens) {
+            offset += token.size();
+            writer.writeUint64(offset);
+        }
+        for (uint64_t count : counts) {
+            writer.writeUint64(count);
+        }
+        for (std::string_view token : tokens) {
+            writer.write(token);
+        }
+        if (!writer.flush()) {
+            errorMessage = "Failed to write '" + path + "'.";
+        }
+    }
+    if (fclose(file) != 0 && errorMessage.empty()) {
+        errorMessage = "Failed to write '" + path + "'.";
+    }
+    return errorMessage.empty();
+}
+
+// Memory-mapped dictionary file
+class DictionaryFile {
+public:
+    bool open(const std::string &path, std::string &errorMessage) {
+        if (!mapping.open(path, errorMessage)) {
+            return false;
+        }
+        data = mapping.view();
+        if (data.size() < DICTIONARY_HEADER_SIZE ||
+            data.substr(0, sizeof(DICTIONARY_MAGIC)) != std::string_view(DICTIONARY_MAGIC, sizeof(DICTIONARY_MAGIC))) {
+            errorMessage = "'" + path + "' is not a dictionary file.";
+            return false;
+        }
+        uint32_t version = loadUint32(data.data() + 4);
+        if (version != DICTIONARY_VERSION) {
+            errorMessage = "'" + path + "' has unsupported dictionary version " + std::to_string(version) + ".";
+            return false;
+        }
+        tokenCount = loadUint64(data.data() + 8);
+        storedFingerprint = loadUint64(data.data() + 16);
+        uint64_t blobBytes = loadUint64(data.data() + 24);
+        uint64_t tableBytes = data.size() - DICTIONARY_HEADER_SIZE;
+        if (tokenCount > tableBytes / 16 || blobBytes != tableBytes - (tokenCount * 16 + 8)) {
+            errorMessage = "'" + path + "' is truncated or corrupt.";
+            return false;
+        }
+        offsets = data.data() + DICTIONARY_HEADER_SIZE;
+        counts = offsets + (tokenCount + 1) * 8;
+        blob = counts + tokenCount * 8;
+        uint64_t previous = 0;
+        for (uint64_t rank = 0; rank <= tokenCount; ++rank) { // Check once so token() needs no checks
+            uint64_t offset = loadUint64(offsets + rank * 8);
+            if (offset < previous || offset > blobBytes || (rank == 0 && offset != 0)) {
+                errorMessage = "'" + path + "' has a corrupt offset table.";
+                return false;
+            }
+            previous = offset;
+        }
+        return true;
+    }
+
+    size_t size() const { return (size_t)tokenCount; }
+
+    uint64_t fingerprint() const { return storedFingerprint; }
+
+    // Token at 0-based rank (position - 1)
+    std::string_view token(size_t rank) const {
+        uint64_t begin = loadUint64(offsets + rank * 8);
+        uint64_t end = loadUint64(offsets + rank * 8 + 8);
+        return std::string_view(blob + begin, (size_t)(end - begin));
+    }
+
+    uint64_t count(size_t rank) const { return loadUint64(counts + rank * 8); }
+
+    // All tokens in rank order, as views into the mapping
+    std::vector<std::string_view> tokens() const {
+        std::vector<std::string_view> list;
+        list.reserve(size());
+        for (size_t rank = 0; rank < size(); ++rank) {
+            list.push_back(token(rank));
+        }
+        return list;
+    }
+
+private:
+    MappedFile mapping;
+    std::string_view data;
+    uint64_t tokenCount = 0;
+    uint64_t storedFingerprint = 0;
+    const char *offsets = nullptr;
+    const char *counts = nullptr;
+    const char *blob = nullptr;
+};
+
+#endif // DICTIONARY_FILE_H
@@ -0,0 +1,396 @@
+/*
+ * File Name: encoded_format.h
+ *
+ * Description:
+ * Compact binary container for encoded text, written by `project5 --binary` and read by
+ * `project5_decompress --decode`. All integers are LEB128 varints unless noted.
+ *
+ *   magic            4 bytes "P5EN"
+ *   version          1 byte (CONTAINER_VERSION)
+ *   flags            1 byte (CONTAINER_FLAG_* bits)
+ *   tokenCount       number of dictionary entries
+ *   idCount          number of encoded positions
+ *   dictionaryBytes  size of the dictionary block that follows
+ *   dictionary       tokenCount entries of (length, bytes), in sorted order
+ *   positions        idCount positions (1-based, as everywhere else)
+ *
+ * Frequency ordering puts the most common tokens at the smallest positions, so most positions
+ * take one or two bytes.
+ *
+ * With CONTAINER_FLAG_FRAMED (`project5 --framed`) the positions are cut into frames of a fixed
+ * number of tokens (the last frame may be shorter), and a frame index is appended after them:
+ *
+ *   frame entries    one per frame: byte offset of its first position from the start of the
+ *                    container, then its token count (8-byte little-endian integers each)
+ *   frameCount       8-byte little-endian integer
+ *   index magic      4 bytes "P5IX"
+ *
+ * Every frame starts on a varint boundary and decodes on its own, so a reader can seek to any
+ * token through the index and decode frames in parallel.
+ *
+ * With CONTAINER_FLAG_HUFFMAN (`project5 --huffman`) a code table follows the dictionary block
+ * (maxLength, then the number of positions with each code length 1..maxLength) and the positions
+ * are a canonical Huffman bitstream (entropy_coder.h) instead of varints. In a framed container
+ * each frame's bitstream is padded to a whole byte.
+ *
+ * With CONTAINER_FLAG_EXTERNAL_DICTIONARY (`project5 --dict-in`) the dictionary block is empty
+ * and positions refer to a saved dictionary file (dictionary_file.h). Its token count (varint)
+ * and fingerprint (8-byte little-endian) follow the dictionary block, so the decoder can check
+ * it was given the same file. With CONTAINER_FLAG_ESCAPES a position of 0 is an escape: the
+ * token's length and bytes follow it in place of a dictionary reference.
+ *
+ * With CONTAINER_FLAG_SEPARATORS (`project5 --lossless`) a separator block follows the code
+ * table (or the dictionary block): its size in bytes, then the whitespace runs between tokens
+ * (separator_stream.h), so the decoder can restore the input exactly.
+ *
+ * With CONTAINER_FLAG_COUNTS (`project5 --store-counts`) a count table follows last: one byte
+ * with the width W (1 to 8) of every count, then the count of each dictionary entry as a W-byte
+ * little-endian integer, in dictionary order. The counts are the ones the ranking was built
+ * from, so `project5_query --count` answers from the header in O(1) without reading positions.
+ */
+
+#ifndef ENCODED_FORMAT_H
+#define ENCODED_FORMAT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "entropy_coder.h"
+#include "output_writer.h"
+
+inline constexpr char CONTAINER_MAGIC[4] = {'P', '5', 'E', 'N'};
+inline constexpr char FRAME_INDEX_MAGIC[4] = {'P', '5', 'I', 'X'};
+const uint8_t CONTAINER_VERSION = 1;
+
+// Header flag bits
+const uint8_t CONTAINER_FLAG_FRAMED = 0x01;  // Positions are split into indexed frames
+const uint8_t CONTAINER_FLAG_HUFFMAN = 0x02; // Positions are Huffman coded
+const uint8_t CONTAINER_FLAG_ESCAPES = 0x04; // Position 0 is followed by a literal token
+const uint8_t CONTAINER_FLAG_EXTERNAL_DICTIONARY = 0x08; // Positions refer to a dictionary file
+const uint8_t CONTAINER_FLAG_SEPARATORS = 0x10; // A separator block keeps the original whitespace
+const uint8_t CONTAINER_FLAG_COUNTS = 0x20;     // A count table gives each dictionary entry's count
+
+// Default number of tokens per frame
+const uint64_t DEFAULT_FRAME_SIZE = 1 << 16;
+
+// Size of one frame index entry and of the fixed index trailer
+const size_t FRAME_ENTRY_SIZE = 16;
+const size_t FRAME_TRAILER_SIZE = 12;
+
+// Number of bytes the value takes as a varint
+inline size_t varintSize(uint64_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+// Returns true if the buffer starts with the container magic
+inline bool isContainer(std::string_view data) {
+    return data.size() >= sizeof(CONTAINER_MAGIC) &&
+           data.compare(0, sizeof(CONTAINER_MAGIC), std::string_view(CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC))) == 0;
+}
+
+// Writes the container header and the dictionary block
+// `dictionary` lists the tokens in sorted order
+template <typename TokenList>
+void writeContainerHeader(OutputWriter &writer, const TokenList &dictionary, uint64_t idCount, uint8_t flags = 0) {
+    writer.write(std::string_view(CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC)));
+    writer.put((char)CONTAINER_VERSION);
+    writer.put((char)flags);
+    uint64_t dictionaryBytes = 0;
+    for (std::string_view token : dictionary) {
+        dictionaryBytes += varintSize(token.size()) + token.size();
+    }
+    writer.writeVarint(dictionary.size());
+    writer.writeVarint(idCount);
+    writer.writeVarint(dictionaryBytes);
+    for (std::string_view token : dictionary) {
+        writer.writeVarint(token.size());
+        writer.write(token);
+    }
+}
+
+// Writes the Huffman code table that follows the dictionary block
+inline void writeCodeTable(OutputWriter &writer, const std::vector<uint64_t> &lengthCounts) {
+    size_t maxLength = 0;
+    for (size_t length = 1; length < lengthCounts.size(); ++length) {
+        if (lengthCounts[length] > 0) {
+            maxLength = length;
+        }
+    }
+    writer.writeVarint(maxLength);
+    for (size_t length = 1; length <= maxLength; ++length) {
+        writer.writeVarint(lengthCounts[length]);
+    }
+}
+
+// Writes the reference to the dictionary file that follows the (empty) dictionary block
+inline void writeExternalDictionaryReference(OutputWriter &writer, uint64_t tokenCount, uint64_t fingerprint) {
+    writer.writeVarint(tokenCount);
+    writer.writeUint64(fingerprint);
+}
+
+// Writes the count table that follows the other header blocks (CONTAINER_FLAG_COUNTS)
+// `counts` holds the count of every dictionary entry, in dictionary order
+inline void writeCountTable(OutputWriter &writer, const std::vector<uint64_t> &counts) {
+    uint64_t largest = 0;
+    for (uint64_t count : counts) {
+        largest = std::max(largest, count);
+    }
+    uint8_t width = 1;
+    while (width < 8 && (largest >> (8 * width)) != 0) {
+        ++width;
+    }
+    writer.put((char)width);
+    for (uint64_t count : counts) {
+        for (uint8_t byte = 0; byte < width; ++byte) {
+            writer.put((char)(count >> (8 * byte)));
+        }
+    }
+}
+
+// One entry of the frame index
+struct FrameEntry {
+    uint64_t byteOffset; // Offset of the frame's first position from the start of the container
+    uint64_t tokenCount; // Number of positions in the frame
+};
+
+// Tracks frame boundaries while positions are written and appends the frame index at the end
+class FrameIndexWriter {
+public:
+    explicit FrameIndexWriter(uint64_t frameSize = DEFAULT_FRAME_SIZE) : frameSize(frameSize) {}
+
+    // True if the next position will be the first of a new frame
+    bool startsNewFrame() const { return frames.empty() || frames.back().tokenCount == frameSize; }
+
+    // Call before writing each position; opens a new frame every frameSize positions
+    void beforePosition(const OutputWriter &writer) {
+        if (startsNewFrame()) {
+            frames.push_back({writer.bytesWritten(), 0});
+        }
+        frames.back().tokenCount++;
+    }
+
+    void writeIndex(OutputWriter &writer) const {
+        for (const FrameEntry &frame : frames) {
+            writer.writeUint64(frame.byteOffset);
+            writer.writeUint64(frame.tokenCount);
+        }
+        writer.writeUint64(frames.size());
+        writer.write(std::string_view(FRAME_INDEX_MAGIC, sizeof(FRAME_INDEX_MAGIC)));
+    }
+
+private:
+    uint64_t frameSize;
+    std::vector<FrameEntry> frames;
+};
+
+// Reads a little-endian 32-bit integer
+inline uint32_t loadUint32(const char *bytes) {
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; --i) {
+        value = (value << 8) | (uint8_t)bytes[i];
+    }
+    return value;
+}
+
+// Reads a little-endian 64-bit integer
+inline uint64_t loadUint64(const char *bytes) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; --i) {
+        value = (value << 8) | (uint8_t)bytes[i];
+    }
+    return value;
+}
+
+// Reads the frame index from the end of a framed container
+// `positionsStart` is where the first frame must begin (right after the dictionary block)
+inline bool readFrameIndex(std::string_view container, size_t positionsStart, std::vector<FrameEntry> &frames,
+                           size_t &indexStart, std::string &errorMessage) {
+    if (container.size() < positionsStart + FRAME_TRAILER_SIZE ||
+        container.substr(container.size() - sizeof(FRAME_INDEX_MAGIC)) !=
+            std::string_view(FRAME_INDEX_MAGIC, sizeof(FRAME_INDEX_MAGIC))) {
+        errorMessage = "Missing frame index.";
+        return false;
+    }
+    uint64_t frameCount = loadUint64(container.data() + container.size() - FRAME_TRAILER_SIZE);
+    size_t available = container.size() - FRAME_TRAILER_SIZE - positionsStart;
+    if (frameCount > available / FRAME_ENTRY_SIZE) {
+        errorMessage = "Corrupt frame index.";
+        return false;
+    }
+    indexStart = container.size() - FRAME_TRAILER_SIZE - (size_t)frameCount * FRAME_ENTRY_SIZE;
+    frames.clear();
+    frames.reserve((size_t)frameCount);
+    uint64_t previousOffset = positionsStart;
+    for (uint64_t i = 0; i < frameCount; ++i) {
+        const char *entry = container.data() + indexStart + i * FRAME_ENTRY_SIZE;
+        FrameEntry frame = {loadUint64(entry), loadUint64(entry + 8)};
+        if (frame.byteOffset < previousOffset || frame.byteOffset > indexStart) {
+            errorMessage = "Frame " + std::to_string(i) + " has an invalid offset.";
+            return false;
+        }
+        previousOffset = frame.byteOffset;
+        frames.push_back(frame);
+    }
+    return true;
+}
+
+// Bounds-checked reader over an in-memory buffer
+class ByteReader {
+public:
+    explicit ByteReader(std::string_view data, size_t offset = 0) : data(data), offset(offset) {}
+
+    bool readVarint(uint64_t &value) {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (offset >= data.size()) {
+                return false;
+            }
+            uint8_t byte = (uint8_t)data[offset++];
+            value |= (uint64_t)(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false; // More than 10 bytes is not a valid 64-bit varint
+    }
+
+    bool readBytes(size_t length, std::string_view &bytes) {
+        if (length > data.size() - offset) {
+            return false;
+        }
+        bytes = data.substr(offset, length);
+        offset += length;
+        return true;
+    }
+
+    bool readByte(uint8_t &byte) {
+        if (offset >= data.size()) {
+            return false;
+        }
+        byte = (uint8_t)data[offset++];
+        return true;
+    }
+
+    size_t position() const { return offset; }
+    size_t remaining() const { return data.size() - offset; }
+
+private:
+    std::string_view data;
+    size_t offset = 0;
+};
+
+// Parsed container header; dictionary entries are views into the container buffer
+struct ContainerHeader {
+    uint8_t version = 0;
+    uint8_t flags = 0;
+    uint64_t idCount = 0;
+    std::vector<std::string_view> dictionary;
+    std::vector<uint64_t> codeLengthCounts; // Huffman containers: positions per code length
+    uint64_t externalTokenCount = 0;        // External dictionary containers: the file's token count
+    uint64_t externalFingerprint = 0;       // and fingerprint
+    std::string_view separatorBlock;        // Lossless containers: the separator block
+    std::string_view countTable;            // Containers with counts: countWidth bytes per entry
+    uint8_t countWidth = 0;
+};
+
+// Count of the dictionary entry at a 1-based position, read from the count table
+// The container must have CONTAINER_FLAG_COUNTS and the position must be in the dictionary
+inline uint64_t storedCount(const ContainerHeader &header, uint64_t position) {
+    const char *bytes = header.countTable.data() + (position - 1) * header.countWidth;
+    uint64_t count = 0;
+    for (uint8_t byte = 0; byte < header.countWidth; ++byte) {
+        count |= (uint64_t)(uint8_t)bytes[byte] << (8 * byte);
+    }
+    return count;
+}
+
+// Reads the header and dictionary block; on success the reader is left at the first position
+inline bool readContainerHeader(ByteReader &reader, ContainerHeader &header, std::string &errorMessage) {
+    std::string_view magic;
+    if (!reader.readBytes(sizeof(CONTAINER_MAGIC), magic) || !isContainer(magic)) {
+        errorMessage = "Input is not an encoded container.";
+        return false;
+    }
+    uint64_t tokenCount, dictionaryBytes;
+    if (!reader.readByte(header.version) || !reader.readByte(header.flags) || !reader.readVarint(tokenCount) ||
+        !reader.readVarint(header.idCount) || !reader.readVarint(dictionaryBytes)) {
+        errorMessage = "Truncated container header.";
+        return false;
+    }
+    if (header.version != CONTAINER_VERSION) {
+        errorMessage = "Unsupported container version " + std::to_string(header.version) + ".";
+        return false;
+    }
+    if (dictionaryBytes > reader.remaining() || tokenCount > dictionaryBytes) {
+        errorMessage = "Truncated dictionary block.";
+        return false;
+    }
+    size_t dictionaryEnd = reader.position() + dictionaryBytes;
+    header.dictionary.clear();
+    header.dictionary.reserve(tokenCount);
+    for (uint64_t i = 0; i < tokenCount; ++i) {
+        uint64_t length;
+        std::string_view token;
+        if (!reader.readVarint(length) || !reader.readBytes(length, token) || reader.position() > dictionaryEnd) {
+            errorMessage = "Corrupt dictionary entry " + std::to_string(i) + ".";
+            return false;
+        }
+        header.dictionary.push_back(token);
+    }
+    if (reader.position() != dictionaryEnd) {
+        errorMessage = "Dictionary block size does not match its entries.";
+        return false;
+    }
+    header.codeLengthCounts.clear();
+    if (header.flags & CONTAINER_FLAG_HUFFMAN) {
+        uint64_t maxLength;
+        if (!reader.readVarint(maxLength) || maxLength > MAX_CODE_LENGTH) {
+            errorMessage = "Corrupt Huffman code table.";
+            return false;
+        }
+        header.codeLengthCounts.assign(MAX_CODE_LENGTH + 1, 0);
+        for (uint64_t length = 1; length <= maxLength; ++length) {
+            if (!reader.readVarint(header.codeLengthCounts[length])) {
+                errorMessage = "Truncated Huffman code table.";
+                return false;
+            }
+        }
+    }
+    if (header.flags & CONTAINER_FLAG_EXTERNAL_DICTIONARY) {
+        std::string_view fingerprint;
+        if (!reader.readVarint(header.externalTokenCount) || !reader.readBytes(8, fingerprint)) {
+            errorMessage = "Truncated dictionary file reference.";
+            return false;
+        }
+        header.externalFingerprint = loadUint64(fingerprint.data());
+    }
+    header.separatorBlock = std::string_view();
+    if (header.flags & CONTAINER_FLAG_SEPARATORS) {
+        uint64_t separatorBytes;
+        if (!reader.readVarint(separatorBytes) || !reader.readBytes(separatorBytes, header.separatorBlock)) {
+            errorMessage = "Truncated separator block.";
+            return false;
+        }
+    }
+    header.countTable = std::string_view();
+    header.countWidth = 0;
+    if (header.flags & CONTAINER_FLAG_COUNTS) {
+        if (!reader.readByte(header.countWidth) || header.countWidth == 0 || header.countWidth > 8 ||
+            !reader.readBytes(tokenCount * header.countWidth, header.countTable)) {
+            errorMessage = "Truncated count table.";
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif // ENCODED_FORMAT_H
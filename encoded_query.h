@@ -0,0 +1,188 @@
+/*
+ * File Name: encoded_query.h
+ *
+ * Description:
+ * Token queries on a binary container (encoded_format.h) that never decode it to text. The
+ * query token is looked up in the dictionary once, which turns it into a single position, and
+ * the position stream is then searched for that number: no token bytes are copied and no text
+ * is built, so a scan runs at the speed of varint unpacking.
+ *
+ * Plain varint positions are unpacked DECODE_BLOCK_SIZE at a time (decode_kernel.h) and every
+ * block is matched and range-checked with branch-free loops the compiler vectorizes; the
+ * matching indexes are only collected for blocks that hold a match. Huffman-coded and escaped
+ * streams go through the decoder's position sources (text_codec.h), and escape literals are
+ * compared with the query bytes, so tokens missing from the dictionary are found as well.
+ *
+ * Containers written with `project5 --store-counts` answer count queries from their count
+ * table (CONTAINER_FLAG_COUNTS) without reading a single position.
+ */
+
+#ifndef ENCODED_QUERY_H
+#define ENCODED_QUERY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "decode_kernel.h"
+#include "encoded_format.h"
+#include "entropy_coder.h"
+#include "separator_stream.h"
+#include "text_codec.h"
+
+// A token to search for and its 1-based dictionary position (0 if it is not in the dictionary)
+struct TokenQuery {
+    std::string_view token;
+    uint64_t position = 0;
+};
+
+// Looks the token up in the rank -> token table of a container
+inline TokenQuery makeTokenQuery(const std::vector<std::string_view> &dictionary, std::string_view token) {
+    TokenQuery query;
+    query.token = token;
+    auto found = std::find(dictionary.begin(), dictionary.end(), token);
+    if (found != dictionary.end()) {
+        query.position = (uint64_t)(found - dictionary.begin()) + 1;
+    }
+    return query;
+}
+
+// Matches in one run of positions
+// `indexes` (if not null) receives the index of every match, counted from the start of the run
+struct QueryMatches {
+    uint64_t count = 0;
+    std::vector<uint64_t> *indexes = nullptr;
+
+    void add(uint64_t index) {
+        ++count;
+        if (indexes != nullptr) {
+            indexes->push_back(index);
+        }
+    }
+};
+
+// Searches `count` positions read from a position source (Huffman or escaped streams)
+template <typename PositionSource>
+bool scanPositions(PositionSource &source, uint64_t dictionarySize, uint64_t count, const TokenQuery &query,
+                   QueryMatches &matches, std::string &errorMessage) {
+    for (uint64_t t = 0; t < count; ++t) {
+        uint64_t position;
+        std::string_view literal;
+        if (!source.next(position, literal)) {
+            errorMessage = "Truncated or corrupt position stream.";
+            return false;
+        }
+        if ((position == 0 && literal.empty()) || position > dictionarySize) {
+            errorMessage = "Invalid position " + std::to_string(position);
+            return false;
+        }
+        if (position == 0 ? literal == query.token : position == query.position) {
+            matches.add(t);
+        }
+    }
+    return true;
+}
+
+// Searches `count` plain varint positions in bytes[start, end) for query.position
+inline bool scanVarintRun(std::string_view bytes, size_t start, size_t end, uint64_t dictionarySize, uint64_t count,
+                          const TokenQuery &query, QueryMatches &matches, std::string &errorMessage) {
+    const uint8_t *data = (const uint8_t *)bytes.data();
+    size_t offset = start;
+    uint64_t values[DECODE_BLOCK_SIZE];
+    for (uint64_t done = 0; done < count;) {
+        size_t blockSize = (size_t)std::min<uint64_t>(DECODE_BLOCK_SIZE, count - done);
+        size_t unpacked = unpackVarints(data, end, offset, values, blockSize);
+        if (unpacked < blockSize) {
+            errorMessage = "Truncated or corrupt position stream.";
+            return false;
+        }
+        uint64_t invalid = 0;
+        uint64_t blockMatches = 0;
+        for (size_t i = 0; i < blockSize; ++i) { // Branch-free: position 0 wraps around and fails too
+            invalid |= (uint64_t)(values[i] - 1 >= dictionarySize);
+            blockMatches += (uint64_t)(values[i] == query.position);
+        }
+        if (invalid != 0) {
+            size_t bad = 0;
+            while (values[bad] - 1 < dictionarySize) {
+                ++bad;
+            }
+            errorMessage = "Invalid position " + std::to_string(values[bad]);
+            return false;
+        }
+        if (matches.indexes == nullptr) {
+            matches.count += blockMatches;
+        } else if (blockMatches > 0) {
+            for (size_t i = 0; i < blockSize; ++i) {
+                if (values[i] == query.position) {
+                    matches.add(done + i);
+                }
+            }
+        }
+        done += blockSize;
+    }
+    return true;
+}
+
+// Searches positions [0, count) of a container byte range with the right position source
+inline bool scanRange(const ContainerHeader &header, uint64_t dictionarySize, const HuffmanDecoder &huffman,
+                      std::string_view container, size_t start, size_t end, uint64_t count, const TokenQuery &query,
+                      QueryMatches &matches, std::string &errorMessage) {
+    if (header.flags & CONTAINER_FLAG_HUFFMAN) {
+        HuffmanPositions source(huffman, container, start, end);
+        return scanPositions(source, dictionarySize, count, query, matches, errorMessage);
+    }
+    if (header.flags & CONTAINER_FLAG_ESCAPES) {
+        VarintPositions source(container, start, end, true);
+        return scanPositions(source, dictionarySize, count, query, matches, errorMessage);
+    }
+    if (query.position == 0) { // Not in the dictionary and no escapes: nothing to find
+        return true;
+    }
+    return scanVarintRun(container, start, end, dictionarySize, count, query, matches, errorMessage);
+}
+
+// Finds the lines of a lossless container that hold the query token
+// The separator runs are read alongside the positions and their newlines counted, so `lines`
+// receives every 1-based line number holding a match, once and in increasing order
+inline bool scanLosslessLines(const ContainerHeader &header, uint64_t dictionarySize, const HuffmanDecoder &huffman,
+                              std::string_view container, size_t start, size_t end, const TokenQuery &query,
+                              std::vector<uint64_t> &lines, std::string &errorMessage) {
+    SeparatorReader separators;
+    if (!separators.open(header.separatorBlock, errorMessage)) {
+        return false;
+    }
+    HuffmanPositions huffmanSource(huffman, container, start, end);
+    VarintPositions varintSource(container, start, end, (header.flags & CONTAINER_FLAG_ESCAPES) != 0);
+    uint64_t line = 1;
+    for (uint64_t t = 0; t < header.idCount; ++t) {
+        uint64_t position;
+        std::string_view literal;
+        std::string_view separator;
+        bool read = (header.flags & CONTAINER_FLAG_HUFFMAN) ? huffmanSource.next(position, literal)
+                                                            : varintSource.next(position, literal);
+        if (!read) {
+            errorMessage = "Truncated or corrupt position stream.";
+            return false;
+        }
+        if ((position == 0 && literal.empty()) || position > dictionarySize) {
+            errorMessage = "Invalid position " + std::to_string(position);
+            return false;
+        }
+        if (!separators.next(separator)) {
+            errorMessage = "Truncated or corrupt separator stream.";
+            return false;
+        }
+        line += (uint64_t)std::count(separator.begin(), separator.end(), '\n');
+        bool matched = position == 0 ? literal == query.token : position == query.position;
+        if (matched && (lines.empty() || lines.back() != line)) {
+            lines.push_back(line);
+        }
+    }
+    return true;
+}
+
+#endif // ENCODED_QUERY_H
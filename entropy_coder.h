@@ -0,0 +1,292 @@
+/*
+ * File Name: entropy_coder.h
+ *
+ * Description:
+ * Canonical Huffman coding of the position sequence. The model is the token frequencies the
+ * encoder already computed: position p has the frequency of the p-th token in sortedTokens.
+ * Because positions are already in descending frequency order, code lengths never decrease
+ * with the position, and the whole code is described by how many positions get each length.
+ * That histogram (at most MAX_CODE_LENGTH numbers) is all the decoder needs to rebuild it.
+ *
+ * Code lengths come from the in-place minimum-redundancy algorithm of Moffat and Katajainen,
+ * which runs in linear time on sorted weights, and are then limited to MAX_CODE_LENGTH bits.
+ * Codes are written most significant bit first. The decoder resolves codes of up to
+ * LOOKUP_BITS bits with one table lookup and walks the canonical limits for longer ones.
+ */
+
+#ifndef ENTROPY_CODER_H
+#define ENTROPY_CODER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "output_writer.h"
+
+// Longest code length the coder produces
+const int MAX_CODE_LENGTH = 30;
+
+// Code lengths resolved by a single lookup in the decoder
+const int LOOKUP_BITS = 11;
+
+// Computes code lengths for symbols whose counts are sorted in descending order
+// (which is how positions are ordered). The returned lengths never decrease.
+inline std::vector<uint8_t> buildCodeLengths(const std::vector<uint64_t> &descendingCounts) {
+    size_t n = descendingCounts.size();
+    std::vector<uint8_t> lengths(n, 0);
+    if (n == 0) {
+        return lengths;
+    }
+    if (n == 1) {
+        lengths[0] = 1;
+        return lengths;
+    }
+
+    // Moffat-Katajainen in place on ascending weights: A[i] = count of symbol n - 1 - i
+    std::vector<uint64_t> A(n);
+    for (size_t i = 0; i < n; ++i) {
+        A[i] = std::max<uint64_t>(1, descendingCounts[n - 1 - i]);
+    }
+    // First pass, left to right, setting parent pointers
+    A[0] += A[1];
+    size_t root = 0, leaf = 2;
+    for (size_t next = 1; next < n - 1; ++next) {
+        if (leaf >= n || A[root] < A[leaf]) { // Select the first item of the pair
+            A[next] = A[root];
+            A[root++] = next;
+        } else {
+            A[next] = A[leaf++];
+        }
+        if (leaf >= n || (root < next && A[root] < A[leaf])) { // Add on the second item
+            A[next] += A[root];
+            A[root++] = next;
+        } else {
+            A[next] += A[leaf++];
+        }
+    }
+    // Second pass, right to left, setting internal node depths
+    A[n - 2] = 0;
+    for (size_t next = n - 2; next-- > 0;) {
+        A[next] = A[A[next]] + 1;
+    }
+    // Third pass, right to left, setting leaf depths
+    long long available = 1, used = 0, depth = 0;
+    long long rootIndex = (long long)n - 2, nextIndex = (long long)n - 1;
+    while (available > 0) {
+        while (rootIndex >= 0 && (long long)A[rootIndex] == depth) {
+            ++used;
+            --rootIndex;
+        }
+        while (available > used) {
+            A[nextIndex--] = (uint64_t)depth;
+            --available;
+        }
+        available = 2 * used;
+        ++depth;
+        used = 0;
+    }
+
+    // Limit the lengths, then restore the Kraft inequality by lengthening the longest codes
+    // that are still below the limit (the least frequent of the shorter codes)
+    uint64_t kraftTarget = (uint64_t)1 << MAX_CODE_LENGTH;
+    uint64_t kraftSum = 0;
+    for (size_t rank = 0; rank < n; ++rank) {
+        uint64_t length = std::min<uint64_t>(A[n - 1 - rank], MAX_CODE_LENGTH);
+        lengths[rank] = (uint8_t)length;
+        kraftSum += (uint64_t)1 << (MAX_CODE_LENGTH - length);
+    }
+    size_t candidate = n;
+    while (kraftSum > kraftTarget) {
+        while (candidate > 0 && lengths[candidate - 1] >= MAX_CODE_LENGTH) {
+            --candidate;
+        }
+        size_t rank = candidate - 1; // Some code is shorter than the limit while the sum is too big
+        kraftSum -= (uint64_t)1 << (MAX_CODE_LENGTH - lengths[rank] - 1);
+        lengths[rank]++;
+    }
+    return lengths;
+}
+
+// Canonical code assignment shared by the encoder and decoder
+// lengthCounts[L] is the number of symbols with an L-bit code; symbols take consecutive codes
+// in rank order within each length
+struct CanonicalCode {
+    std::vector<uint64_t> lengthCounts; // Index 0..MAX_CODE_LENGTH
+    uint32_t firstCode[MAX_CODE_LENGTH + 2] = {};
+    uint64_t firstSymbol[MAX_CODE_LENGTH + 2] = {};
+
+    // Fills firstCode/firstSymbol; returns false if the counts do not form a prefix code
+    bool assign() {
+        lengthCounts.resize(MAX_CODE_LENGTH + 1, 0);
+        uint64_t code = 0, symbol = 0;
+        for (int length = 1; length <= MAX_CODE_LENGTH; ++length) {
+            code <<= 1;
+            firstCode[length] = (uint32_t)code;
+            firstSymbol[length] = symbol;
+            code += lengthCounts[length];
+            symbol += lengthCounts[length];
+            if (code > ((uint64_t)1 << length)) {
+                return false; // Oversubscribed
+            }
+        }
+        return lengthCounts[0] == 0;
+    }
+
+    uint64_t symbolCount() const {
+        uint64_t total = 0;
+        for (uint64_t count : lengthCounts) {
+            total += count;
+        }
+        return total;
+    }
+};
+
+// Encoder side: the code and length of every symbol, indexed by position - 1
+struct HuffmanEncoder {
+    CanonicalCode canonical;
+    std::vector<uint32_t> codes;
+    std::vector<uint8_t> lengths;
+
+    void build(const std::vector<uint64_t> &descendingCounts) {
+        lengths = buildCodeLengths(descendingCounts);
+        canonical.lengthCounts.assign(MAX_CODE_LENGTH + 1, 0);
+        for (uint8_t length : lengths) {
+            canonical.lengthCounts[length]++;
+        }
+        canonical.assign();
+        codes.resize(lengths.size());
+        for (size_t rank = 0; rank < lengths.size(); ++rank) {
+            int length = lengths[rank];
+            codes[rank] = canonical.firstCode[length] + (uint32_t)(rank - canonical.firstSymbol[length]);
+        }
+    }
+};
+
+// Writes codes most significant bit first into an OutputWriter
+class BitWriter {
+public:
+    explicit BitWriter(OutputWriter &writer) : writer(writer) {}
+
+    void write(uint32_t code, int length) {
+        bits = (bits << length) | code;
+        bitCount += length;
+        while (bitCount >= 8) {
+            bitCount -= 8;
+            writer.put((char)(bits >> bitCount));
+        }
+    }
+
+    // Pads the last partial byte with zero bits
+    void alignToByte() {
+        if (bitCount > 0) {
+            writer.put((char)(bits << (8 - bitCount)));
+            bitCount = 0;
+        }
+    }
+
+private:
+    OutputWriter &writer;
+    uint64_t bits = 0;
+    int bitCount = 0;
+};
+
+// Reads bits most significant bit first from a byte range, padding past the end with zeros
+class BitReader {
+public:
+    explicit BitReader(std::string_view data)
+        : cursor((const uint8_t *)data.data()), end((const uint8_t *)data.data() + data.size()) {
+        refill();
+    }
+
+    void refill() {
+        while (bitCount <= 56) {
+            uint64_t byte = 0;
+            if (cursor < end) {
+                byte = *cursor++;
+            } else {
+                ++paddingBytes;
+            }
+            window |= byte << (56 - bitCount);
+            bitCount += 8;
+        }
+    }
+
+    uint64_t peek(int length) const { return window >> (64 - length); }
+
+    void consume(int length) {
+        window <<= length;
+        bitCount -= length;
+    }
+
+    // True once bits beyond the end of the data have been consumed
+    bool overrun() const { return (long long)bitCount < (long long)paddingBytes * 8; }
+
+private:
+    const uint8_t *cursor;
+    const uint8_t *end;
+    uint64_t window = 0;
+    int bitCount = 0;
+    uint64_t paddingBytes = 0;
+};
+
+// Table-driven canonical Huffman decoder
+class HuffmanDecoder {
+public:
+    // Builds the decoding tables from the code length histogram
+    bool build(const std::vector<uint64_t> &lengthCounts) {
+        canonical.lengthCounts = lengthCounts;
+        if (!canonical.assign()) {
+            return false;
+        }
+        maxLength = 0;
+        for (int length = 1; length <= MAX_CODE_LENGTH; ++length) {
+            if (canonical.lengthCounts[length] > 0) {
+                maxLength = length;
+            }
+        }
+        lookup.assign((size_t)1 << LOOKUP_BITS, {0, 0});
+        for (int length = 1; length <= std::min(maxLength, LOOKUP_BITS); ++length) {
+            for (uint64_t i = 0; i < canonical.lengthCounts[length]; ++i) {
+                uint32_t code = canonical.firstCode[length] + (uint32_t)i;
+                size_t first = (size_t)code << (LOOKUP_BITS - length);
+                size_t span = (size_t)1 << (LOOKUP_BITS - length);
+                for (size_t slot = first; slot < first + span; ++slot) {
+                    lookup[slot] = {(uint32_t)(canonical.firstSymbol[length] + i), (uint8_t)length};
+                }
+            }
+        }
+        return true;
+    }
+
+    // Decodes one symbol (position - 1); returns -1 for a bit pattern that is not a code
+    long long decode(BitReader &reader) const {
+        reader.refill();
+        const LookupEntry &entry = lookup[(size_t)reader.peek(LOOKUP_BITS)];
+        if (entry.length != 0) {
+            reader.consume(entry.length);
+            return entry.symbol;
+        }
+        for (int length = LOOKUP_BITS + 1; length <= maxLength; ++length) {
+            uint64_t offset = reader.peek(length) - canonical.firstCode[length];
+            if (offset < canonical.lengthCounts[length]) {
+                reader.consume(length);
+                return (long long)(canonical.firstSymbol[length] + offset);
+            }
+        }
+        return -1;
+    }
+
+private:
+    struct LookupEntry {
+        uint32_t symbol;
+        uint8_t length; // 0 when the code is longer than LOOKUP_BITS
+    };
+
+    CanonicalCode canonical;
+    std::vector<LookupEntry> lookup;
+    int maxLength = 0;
+};
+
+#endif // ENTROPY_CODER_H
@@ -0,0 +1,232 @@
+/*
+ * File Name: flat_token_map.h
+ *
+ * Description:
+ * Flat open-addressing hash table from token to dense id, laid out SwissTable-style. The table
+ * is two flat arrays: one control byte per slot (0x80 for empty, otherwise the low 7 bits of the
+ * token's hash) and one 32-bit id per slot. Slots are probed in groups of 16 control bytes, and a
+ * whole group is matched against the hash tag with one SSE2 compare on x86-64, so most lookups
+ * touch one cache line of control bytes and compare a single candidate string.
+ *
+ * The table does not store tokens. A slot holds an id, and the caller's id -> token array
+ * (TokenTable::idTokens) supplies the key bytes for comparisons and for rehashing. That keeps a
+ * slot at 5 bytes, whatever the token length. Entries are never erased; ids are only appended.
+ * Both arrays follow the memory policy of memory_placement.h (huge pages on request).
+ */
+
+#ifndef FLAT_TOKEN_MAP_H
+#define FLAT_TOKEN_MAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "memory_placement.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FLAT_TOKEN_MAP_SSE2 1
+#endif
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// Hashes a token 8 bytes at a time with a multiply-rotate mix and a final avalanche
+inline uint64_t hashToken(std::string_view token) {
+    const uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+    const char *bytes = token.data();
+    size_t length = token.size();
+    uint64_t hash = length * multiplier;
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, bytes, 8);
+        hash = (hash ^ word) * multiplier;
+        hash = (hash << 31) | (hash >> 33);
+        bytes += 8;
+        length -= 8;
+    }
+    if (length > 0) {
+        uint64_t word = 0;
+        memcpy(&word, bytes, length);
+        hash = (hash ^ word) * multiplier;
+    }
+    hash ^= hash >> 33; // Finalizer from MurmurHash3 so the low and high bits both mix well
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+class FlatTokenMap {
+public:
+    static constexpr size_t GROUP_SIZE = 16;
+    static constexpr int8_t EMPTY = (int8_t)0x80;
+
+    FlatTokenMap() { allocate(GROUP_SIZE); }
+
+    size_t size() const { return entryCount; }
+    size_t capacity() const { return ids.size(); }
+    size_t memoryBytes() const { return control.size() + ids.size() * sizeof(int32_t); }
+
+    // Returns the id stored for the token, or -1 if it is not in the table
+    // `hash` must be hashToken(token); `keys` maps every stored id to its token
+    int find(std::string_view token, uint64_t hash, const LargeVector<std::string_view> &keys) const {
+        int8_t tag = (int8_t)(hash & 0x7F);
+        size_t groupMask = groupCount() - 1;
+        size_t group = (size_t)(hash >> 7) & groupMask;
+        for (size_t step = 1;; ++step) {
+            const int8_t *groupControl = control.data() + group * GROUP_SIZE;
+            for (uint32_t matches = matchTag(groupControl, tag); matches != 0; matches &= matches - 1) {
+                int32_t id = ids[group * GROUP_SIZE + countTrailingZeros(matches)];
+                if (keys[id] == token) {
+                    return id;
+                }
+            }
+            if (matchTag(groupControl, EMPTY) != 0) {
+                return -1;
+            }
+            group = (group + step) & groupMask; // Triangular probing visits every group
+        }
+    }
+
+    // Returns {existing id, false} if the token is stored, otherwise stores newId for it and
+    // returns {newId, true}. Only ids already stored are looked up in `keys`, so the caller
+    // appends the new token at index newId after an insertion.
+    std::pair<int, bool> findOrInsert(std::string_view token, uint64_t hash, int newId,
+                                      const LargeVector<std::string_view> &keys) {
+        if ((entryCount + 1) * 8 > capacity() * 7) { // Keep the load factor at or below 7/8
+            rehash(capacity() * 2, keys);
+        }
+        int8_t tag = (int8_t)(hash & 0x7F);
+        size_t groupMask = groupCount() - 1;
+        size_t group = (size_t)(hash >> 7) & groupMask;
+        for (size_t step = 1;; ++step) {
+            int8_t *groupControl = control.data() + group * GROUP_SIZE;
+            for (uint32_t matches = matchTag(groupControl, tag); matches != 0; matches &= matches - 1) {
+                int32_t id = ids[group * GROUP_SIZE + countTrailingZeros(matches)];
+                if (keys[id] == token) {
+                    return {id, false};
+                }
+            }
+            uint32_t empties = matchTag(groupControl, EMPTY);
+            if (empties != 0) {
+                size_t slot = group * GROUP_SIZE + countTrailingZeros(empties);
+                control[slot] = tag;
+                ids[slot] = newId;
+                ++entryCount;
+                return {newId, true};
+            }
+            group = (group + step) & groupMask;
+        }
+    }
+
+    // Average number of groups probed to find each stored token (1.0 is ideal)
+    double averageProbeLength(const LargeVector<std::string_view> &keys) const {
+        if (entryCount == 0) {
+            return 0.0;
+        }
+        size_t groupMask = groupCount() - 1;
+        size_t totalProbes = 0;
+        for (size_t slot = 0; slot < ids.size(); ++slot) {
+            if (control[slot] == EMPTY) {
+                continue;
+            }
+            size_t home = (size_t)(hashToken(keys[ids[slot]]) >> 7) & groupMask;
+            size_t target = slot / GROUP_SIZE;
+            size_t probes = 1;
+            for (size_t group = home, step = 1; group != target; group = (group + step) & groupMask, ++step) {
+                ++probes;
+            }
+            totalProbes += probes;
+        }
+        return (double)totalProbes / (double)entryCount;
+    }
+
+    // Sizes the table so that `count` entries fit without rehashing
+    void reserve(size_t count, const LargeVector<std::string_view> &keys) {
+        size_t wanted = GROUP_SIZE;
+        while (wanted * 7 < count * 8) {
+            wanted *= 2;
+        }
+        if (wanted > capacity()) {
+            rehash(wanted, keys);
+        }
+    }
+
+    void clear() {
+        std::fill(control.begin(), control.end(), EMPTY);
+        entryCount = 0;
+    }
+
+private:
+    size_t groupCount() const { return ids.size() / GROUP_SIZE; }
+
+    void allocate(size_t slotCount) {
+        control.assign(slotCount, EMPTY);
+        ids.assign(slotCount, 0);
+        entryCount = 0;
+    }
+
+    // Moves every entry into a table with `slotCount` slots
+    void rehash(size_t slotCount, const LargeVector<std::string_view> &keys) {
+        LargeVector<int8_t> oldControl;
+        LargeVector<int32_t> oldIds;
+        oldControl.swap(control);
+        oldIds.swap(ids);
+        allocate(slotCount);
+        size_t groupMask = groupCount() - 1;
+        for (size_t slot = 0; slot < oldIds.size(); ++slot) {
+            if (oldControl[slot] == EMPTY) {
+                continue;
+            }
+            uint64_t hash = hashToken(keys[oldIds[slot]]);
+            size_t group = (size_t)(hash >> 7) & groupMask;
+            for (size_t step = 1;; ++step) {
+                uint32_t empties = matchTag(control.data() + group * GROUP_SIZE, EMPTY);
+                if (empties != 0) {
+                    size_t newSlot = group * GROUP_SIZE + countTrailingZeros(empties);
+                    control[newSlot] = (int8_t)(hash & 0x7F);
+                    ids[newSlot] = oldIds[slot];
+                    ++entryCount;
+                    break;
+                }
+                group = (group + step) & groupMask;
+            }
+        }
+    }
+
+    // Returns a bit mask of the group's control bytes equal to `tag`
+    static uint32_t matchTag(const int8_t *groupControl, int8_t tag) {
+#ifdef FLAT_TOKEN_MAP_SSE2
+        __m128i bytes = _mm_loadu_si128((const __m128i *)groupControl);
+        return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(tag)));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < GROUP_SIZE; ++i) {
+            mask |= (uint32_t)(groupControl[i] == tag) << i;
+        }
+        return mask;
+#endif
+    }
+
+    static int countTrailingZeros(uint32_t value) {
+#if defined(_MSC_VER) && !defined(__clang__)
+        unsigned long index;
+        _BitScanForward(&index, value);
+        return (int)index;
+#else
+        return __builtin_ctz(value);
+#endif
+    }
+
+    LargeVector<int8_t> control; // One control byte per slot
+    LargeVector<int32_t> ids;    // One id per slot
+    size_t entryCount = 0;
+};
+
+#endif // FLAT_TOKEN_MAP_H
@@ -0,0 +1,138 @@
+/*
+ * File Name: mapped_file.h
+ * 
+ * Description:
+ * Read-only memory mapping of an input file. The encoder tokenizes the mapping in place and
+ * hands out std::string_view tokens that point straight into it, so no token strings are
+ * allocated while counting. Uses mmap on POSIX systems and a file mapping view on Windows.
+ */
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only view of a whole file, unmapped when the object is destroyed
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() { close(); }
+
+    // Maps the file at the given path; returns false and fills errorMessage on failure
+    bool open(const std::string &path, std::string &errorMessage) {
+        close();
+#ifdef _WIN32
+        fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                 FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (fileHandle == INVALID_HANDLE_VALUE) {
+            errorMessage = "Could not open '" + path + "'.";
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(fileHandle, &fileSize)) {
+            errorMessage = "Could not determine the size of '" + path + "'.";
+            close();
+            return false;
+        }
+        length = (size_t)fileSize.QuadPart;
+        if (length == 0) {
+            return true; // Empty files cannot be mapped but are valid input
+        }
+        mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mappingHandle == nullptr) {
+            errorMessage = "Could not map '" + path + "'.";
+            close();
+            return false;
+        }
+        data = (const char *)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+        if (data == nullptr) {
+            errorMessage = "Could not map '" + path + "'.";
+            close();
+            return false;
+        }
+#else
+        fileDescriptor = ::open(path.c_str(), O_RDONLY);
+        if (fileDescriptor < 0) {
+            errorMessage = "Could not open '" + path + "'.";
+            return false;
+        }
+        struct stat fileStatus;
+        if (fstat(fileDescriptor, &fileStatus) != 0) {
+            errorMessage = "Could not determine the size of '" + path + "'.";
+            close();
+            return false;
+        }
+        if (!S_ISREG(fileStatus.st_mode)) {
+            errorMessage = "'" + path + "' is not a regular file; redirect it to standard input instead.";
+            close();
+            return false;
+        }
+        length = (size_t)fileStatus.st_size;
+        if (length == 0) {
+            return true; // Empty files cannot be mapped but are valid input
+        }
+        void *mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+        if (mapping == MAP_FAILED) {
+            errorMessage = "Could not map '" + path + "'.";
+            close();
+            return false;
+        }
+        madvise(mapping, length, MADV_SEQUENTIAL); // The tokenizer reads front to back
+        data = (const char *)mapping;
+#endif
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (data != nullptr) {
+            UnmapViewOfFile(data);
+        }
+        if (mappingHandle != nullptr) {
+            CloseHandle(mappingHandle);
+            mappingHandle = nullptr;
+        }
+        if (fileHandle != INVALID_HANDLE_VALUE) {
+            CloseHandle(fileHandle);
+            fileHandle = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (data != nullptr) {
+            munmap((void *)data, length);
+        }
+        if (fileDescriptor >= 0) {
+            ::close(fileDescriptor);
+            fileDescriptor = -1;
+        }
+#endif
+        data = nullptr;
+        length = 0;
+    }
+
+    std::string_view view() const { return data == nullptr ? std::string_view() : std::string_view(data, length); }
+
+private:
+    const char *data = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+    HANDLE mappingHandle = nullptr;
+#else
+    int fileDescriptor = -1;
+#endif
+};
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,341 @@
+/*
+ * File Name: memory_placement.h
+ *
+ * Description:
+ * Placement of the encoder's big arrays: the buffered input, the intern table (its slots and
+ * id -> token and id -> frequency arrays) and the id sequence. On inputs of tens of gigabytes
+ * these arrays span millions of 4 KiB pages, so lookups miss the TLB, and on machines with
+ * several NUMA nodes a thread may work on memory that another node's threads first touched.
+ *
+ * LargePageAllocator is a std::allocator replacement (LargeVector<T> is a vector using it).
+ * Once a policy is chosen, blocks of LARGE_REGION_MIN_BYTES or more are fresh anonymous mappings
+ * rounded to whole 2 MiB huge pages. What the mapping asks for is chosen at run time
+ * (`project5 --huge-pages`):
+ *
+ *   off          operator new, as before (the default); with --numa-local plain mappings
+ *   transparent  madvise(MADV_HUGEPAGE), so the kernel backs the block with transparent huge
+ *                pages where it can
+ *   explicit     MAP_HUGETLB pages from the reserved hugetlbfs pool; when the pool is empty or
+ *                missing the block falls back to a transparent mapping
+ *
+ * With `project5 --numa-local` the chunk threads of parallel mode (runPerChunk) bind themselves
+ * to a node: chunk i of n runs on node i * nodeCount / n, so neighbouring chunks share a node.
+ * Per-chunk tables and id arrays are first touched by their own thread and so are allocated on
+ * that node, and the buffered input is copied into place a chunk-sized slice per node.
+ *
+ * Everything falls back to plain allocation where it is not supported: other platforms than
+ * Linux allocate with operator new, and a machine with one node is never bound.
+ */
+
+#ifndef MEMORY_PLACEMENT_H
+#define MEMORY_PLACEMENT_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+// Blocks from this size on can be mapped on their own, in whole units of HUGE_PAGE_BYTES
+const size_t LARGE_REGION_MIN_BYTES = 1 << 21;
+const size_t HUGE_PAGE_BYTES = 1 << 21;
+
+// Huge page use of large allocations
+enum class HugePageMode { Off, Transparent, Explicit };
+
+// Run-time memory placement policy, set once from the command line before anything is allocated
+struct MemoryPolicy {
+    HugePageMode hugePages = HugePageMode::Off;
+    bool numaLocal = false; // Bind chunk threads to NUMA nodes in parallel mode
+
+    // True if any placement was asked for
+    bool active() const { return hugePages != HugePageMode::Off || numaLocal; }
+
+    // True if a block of this size is mapped on its own; fresh mappings are first touched by the
+    // thread that fills them, wherever the heap's pages came from
+    bool mapsOwnRegion(size_t bytes) const { return bytes >= LARGE_REGION_MIN_BYTES && active(); }
+
+    // Bytes mapped and explicit blocks that fell back to transparent pages since the last call
+    // (for --stats)
+    uint64_t takeMappedBytes() { return mappedBytes.exchange(0); }
+    uint64_t takeExplicitFallbacks() { return explicitFallbacks.exchange(0); }
+
+    std::atomic<uint64_t> mappedBytes{0};
+    std::atomic<uint64_t> explicitFallbacks{0};
+};
+
+// The process-wide policy
+inline MemoryPolicy &memoryPolicy() {
+    static MemoryPolicy policy;
+    return policy;
+}
+
+// Maps a block of at least `bytes` bytes (a multiple of HUGE_PAGE_BYTES) under the current policy
+inline void *mapLargeRegion(size_t bytes) {
+#ifdef __linux__
+    MemoryPolicy &policy = memoryPolicy();
+    void *block = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (policy.hugePages == HugePageMode::Explicit) {
+        block = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (block == MAP_FAILED) {
+            policy.explicitFallbacks++; // The hugetlbfs pool is empty or not set up
+        }
+    }
+#endif
+    if (block == MAP_FAILED) {
+        block = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (block == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+#ifdef MADV_HUGEPAGE
+        if (policy.hugePages != HugePageMode::Off) {
+            madvise(block, bytes, MADV_HUGEPAGE); // Only a hint; ignored where THP is disabled
+        }
+#endif
+    }
+    policy.mappedBytes += bytes;
+    return block;
+#else
+    return ::operator new(bytes);
+#endif
+}
+
+inline void unmapLargeRegion(void *block, size_t bytes) {
+#ifdef __linux__
+    munmap(block, bytes);
+#else
+    (void)bytes;
+    ::operator delete(block);
+#endif
+}
+
+// Allocator that maps large blocks with mapLargeRegion and leaves the rest to operator new
+// The choice depends on the block size and the fixed policy, so deallocate() matches allocate()
+template <typename T>
+struct LargePageAllocator {
+    using value_type = T;
+
+    LargePageAllocator() = default;
+    template <typename U>
+    LargePageAllocator(const LargePageAllocator<U> &) {}
+
+    T *allocate(size_t count) {
+        size_t bytes = count * sizeof(T);
+        if (!memoryPolicy().mapsOwnRegion(bytes)) {
+            return (T *)::operator new(bytes);
+        }
+        return (T *)mapLargeRegion(roundedRegionBytes(bytes));
+    }
+
+    void deallocate(T *block, size_t count) {
+        size_t bytes = count * sizeof(T);
+        if (!memoryPolicy().mapsOwnRegion(bytes)) {
+            ::operator delete(block);
+            return;
+        }
+        unmapLargeRegion(block, roundedRegionBytes(bytes));
+    }
+
+    static size_t roundedRegionBytes(size_t bytes) {
+        return (bytes + HUGE_PAGE_BYTES - 1) / HUGE_PAGE_BYTES * HUGE_PAGE_BYTES;
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const LargePageAllocator<T> &, const LargePageAllocator<U> &) {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const LargePageAllocator<T> &, const LargePageAllocator<U> &) {
+    return false;
+}
+
+// Vector whose large buffers follow the memory policy
+template <typename T>
+using LargeVector = std::vector<T, LargePageAllocator<T>>;
+
+// Uninitialized byte buffer that follows the memory policy (for the buffered input)
+// Unlike a vector it does not write the bytes when it is sized, so the first write to each
+// page decides its node
+class LargeBuffer {
+public:
+    LargeBuffer() = default;
+    LargeBuffer(const LargeBuffer &) = delete;
+    LargeBuffer &operator=(const LargeBuffer &) = delete;
+    ~LargeBuffer() { release(); }
+
+    void allocate(size_t bytes) {
+        release();
+        capacityBytes = bytes;
+        block = bytes > 0 ? LargePageAllocator<char>().allocate(bytes) : nullptr;
+        length = bytes;
+    }
+
+    // Changes the size, keeping the first min(size(), bytes) bytes; new bytes are uninitialized
+    // The capacity at least doubles when it grows, and a mapped block is grown with mremap, so
+    // reading an input of unknown size into the buffer never holds two copies of it
+    void resize(size_t bytes) {
+        if (bytes <= capacityBytes) {
+            length = bytes;
+            return;
+        }
+        size_t capacity = std::max(bytes, capacityBytes * 2);
+#if defined(__linux__) && defined(MREMAP_MAYMOVE)
+        MemoryPolicy &policy = memoryPolicy();
+        if (policy.mapsOwnRegion(capacityBytes) && policy.mapsOwnRegion(capacity)) {
+            size_t oldBytes = LargePageAllocator<char>::roundedRegionBytes(capacityBytes);
+            size_t newBytes = LargePageAllocator<char>::roundedRegionBytes(capacity);
+            void *moved = mremap(block, oldBytes, newBytes, MREMAP_MAYMOVE);
+            if (moved != MAP_FAILED) {
+                policy.mappedBytes += newBytes - oldBytes;
+                block = (char *)moved;
+                capacityBytes = capacity;
+                length = bytes;
+                return;
+            }
+        }
+#endif
+        char *larger = LargePageAllocator<char>().allocate(capacity); // Not mapped yet, or mremap failed
+        if (length > 0) {
+            memcpy(larger, block, length);
+        }
+        release();
+        block = larger;
+        capacityBytes = capacity;
+        length = bytes;
+    }
+
+    char *data() { return block; }
+    size_t size() const { return length; }
+    std::string_view view() const { return std::string_view(block, length); }
+
+private:
+    void release() {
+        if (block != nullptr) {
+            LargePageAllocator<char>().deallocate(block, capacityBytes);
+        }
+        block = nullptr;
+        length = capacityBytes = 0;
+    }
+
+    char *block = nullptr;
+    size_t length = 0;
+    size_t capacityBytes = 0;
+};
+
+// Parses a sysfs CPU or node list such as "0-3,8-11"
+inline std::vector<int> parseCpuList(const std::string &list) {
+    std::vector<int> values;
+    size_t i = 0;
+    while (i < list.size()) {
+        if (list[i] < '0' || list[i] > '9') {
+            ++i;
+            continue;
+        }
+        int first = 0;
+        while (i < list.size() && list[i] >= '0' && list[i] <= '9') {
+            first = first * 10 + (list[i++] - '0');
+        }
+        int last = first;
+        if (i < list.size() && list[i] == '-') {
+            last = 0;
+            ++i;
+            while (i < list.size() && list[i] >= '0' && list[i] <= '9') {
+                last = last * 10 + (list[i++] - '0');
+            }
+        }
+        for (int value = first; value <= last; ++value) {
+            values.push_back(value);
+        }
+    }
+    return values;
+}
+
+// CPUs of every online NUMA node that has any, read once from sysfs (empty where unknown)
+inline const std::vector<std::vector<int>> &numaNodeCpus() {
+    static const std::vector<std::vector<int>> nodes = [] {
+        std::vector<std::vector<int>> found;
+#ifdef __linux__
+        auto readLine = [](const std::string &path) {
+            std::string line;
+            if (FILE *file = fopen(path.c_str(), "r")) {
+                char buffer[4096];
+                if (fgets(buffer, sizeof(buffer), file) != nullptr) {
+                    line = buffer;
+                }
+                fclose(file);
+            }
+            return line;
+        };
+        for (int node : parseCpuList(readLine("/sys/devices/system/node/online"))) {
+            std::vector<int> cpus =
+                parseCpuList(readLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"));
+            if (!cpus.empty()) {
+                found.push_back(cpus);
+            }
+        }
+#endif
+        return found;
+    }();
+    return nodes;
+}
+
+// Binds the calling thread to the node of chunk `chunk` of `chunkCount` for its lifetime
+// Does nothing unless --numa-local is on and the machine has more than one node
+class ChunkNodeBinding {
+public:
+    ChunkNodeBinding(size_t chunk, size_t chunkCount) {
+#ifdef __linux__
+        const std::vector<std::vector<int>> &nodes = numaNodeCpus();
+        if (!memoryPolicy().numaLocal || nodes.size() < 2 || chunkCount == 0) {
+            return;
+        }
+        if (sched_getaffinity(0, sizeof(previous), &previous) != 0) {
+            return;
+        }
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int cpu : nodes[chunk * nodes.size() / chunkCount]) {
+            if (cpu < CPU_SETSIZE) {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+        bound = sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+#else
+        (void)chunk;
+        (void)chunkCount;
+#endif
+    }
+
+    ChunkNodeBinding(const ChunkNodeBinding &) = delete;
+    ChunkNodeBinding &operator=(const ChunkNodeBinding &) = delete;
+
+    // Restores the previous CPU set (chunk 0 runs on the calling thread)
+    ~ChunkNodeBinding() {
+#ifdef __linux__
+        if (bound) {
+            sched_setaffinity(0, sizeof(previous), &previous);
+        }
+#endif
+    }
+
+private:
+#ifdef __linux__
+    cpu_set_t previous;
+#endif
+    bool bound = false;
+};
+
+#endif // MEMORY_PLACEMENT_H
@@ -0,0 +1,191 @@
+/*
+ * File Name: narrow_ids.h
+ *
+ * Description:
+ * Token id sequence stored at the narrowest byte width its values allow. The encoder keeps
+ * one id per token occurrence of the input, so at 4 bytes per int this array is usually the
+ * largest allocation of a run, while most vocabularies fit in 16 bits and small ones in 8.
+ *
+ * NarrowIdArray starts at 1 byte per id and widens to 2 and then 4 bytes the first time an id
+ * does not fit (so at most two copies are ever made, early in the input). After the ranking the
+ * provisional ids are replaced by their positions in place: the positions take the same range
+ * as the ids, so the array never needs a second full-size copy. Values are stored relative to a
+ * bias (the smallest value), which keeps escape values of --top-k (negative) in the same width.
+ *
+ * The widths are whole bytes rather than bit-packed so that threads can fill disjoint slices
+ * without sharing words, and reading a block back to ints is a plain widening copy.
+ */
+
+#ifndef NARROW_IDS_H
+#define NARROW_IDS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "memory_placement.h"
+
+// Smallest width in bytes (1, 2 or 4) that holds every value up to `range`
+inline int narrowWidthFor(uint32_t range) {
+    return range <= UINT8_MAX ? 1 : range <= UINT16_MAX ? 2 : 4;
+}
+
+// Calls function(T()) with the unsigned type of the given width
+template <typename Function>
+inline void withIdWidth(int width, Function &&function) {
+    switch (width) {
+    case 1:
+        function(uint8_t());
+        break;
+    case 2:
+        function(uint16_t());
+        break;
+    default:
+        function(uint32_t());
+        break;
+    }
+}
+
+class NarrowIdArray {
+public:
+    // Appends a non-negative id, widening the storage if the id does not fit (before remap only)
+    void push(int id) {
+        if ((uint32_t)id > widthLimit) {
+            changeWidth(narrowWidthFor((uint32_t)id));
+        }
+        if ((count + 1) * (size_t)width > bytes.size()) {
+            bytes.resize(std::max<size_t>(4096, bytes.size() * 2));
+        }
+        switch (width) {
+        case 1:
+            store<uint8_t>(count, (uint32_t)id);
+            break;
+        case 2:
+            store<uint16_t>(count, (uint32_t)id);
+            break;
+        default:
+            store<uint32_t>(count, (uint32_t)id);
+            break;
+        }
+        ++count;
+    }
+
+    // Replaces every value v with map[v], in place unless the new values need a wider type
+    void remap(const std::vector<int> &map) {
+        if (map.empty()) {
+            return;
+        }
+        auto [low, high] = std::minmax_element(map.begin(), map.end());
+        int newBias = *low;
+        int newWidth = narrowWidthFor((uint32_t)((int64_t)*high - *low));
+        LargeVector<uint8_t> widened;
+        uint8_t *target = bytes.data();
+        if (newWidth > width) { // A narrower or equal width is written over the values as they are read
+            widened.resize(std::max<size_t>(count, 1) * newWidth);
+            target = widened.data();
+        }
+        withIdWidth(width, [&](auto oldType) {
+            withIdWidth(newWidth, [&](auto newType) {
+                using Old = decltype(oldType);
+                using New = decltype(newType);
+                for (size_t i = 0; i < count; ++i) {
+                    Old value;
+                    memcpy(&value, bytes.data() + i * sizeof(Old), sizeof(Old));
+                    New mapped = (New)(uint32_t)(map[(size_t)((int64_t)value + bias)] - newBias);
+                    memcpy(target + i * sizeof(New), &mapped, sizeof(New));
+                }
+            });
+        });
+        if (newWidth > width) {
+            bytes.swap(widened);
+        }
+        setWidth(newWidth, newBias);
+    }
+
+    // Sizes the array for `newCount` values in [minValue, maxValue], to be filled with set()
+    void resize(size_t newCount, int minValue, int maxValue) {
+        setWidth(narrowWidthFor((uint32_t)((int64_t)maxValue - minValue)), minValue);
+        count = newCount;
+        if (count * (size_t)width > bytes.size()) {
+            bytes.resize(count * (size_t)width);
+        }
+    }
+
+    // Writes values[0, n) at index `first`; threads may fill disjoint ranges at the same time
+    void set(size_t first, const int *values, size_t n) {
+        withIdWidth(width, [&](auto type) {
+            using T = decltype(type);
+            for (size_t i = 0; i < n; ++i) {
+                store<T>(first + i, (uint32_t)(values[i] - bias));
+            }
+        });
+    }
+
+    // Copies values [first, first + n) to `values` as ints
+    void read(size_t first, size_t n, int *values) const {
+        withIdWidth(width, [&](auto type) {
+            using T = decltype(type);
+            for (size_t i = 0; i < n; ++i) {
+                T value;
+                memcpy(&value, bytes.data() + (first + i) * sizeof(T), sizeof(T));
+                values[i] = (int)((int64_t)value + bias);
+            }
+        });
+    }
+
+    size_t size() const { return count; }
+
+    // Bytes per value (1, 2 or 4)
+    int valueWidth() const { return width; }
+
+    // Bytes allocated for the values
+    size_t memoryBytes() const { return bytes.capacity(); }
+
+    // Forgets the values but keeps the allocation
+    void clear() {
+        count = 0;
+        setWidth(1, 0);
+    }
+
+private:
+    template <typename T>
+    void store(size_t index, uint32_t value) {
+        T narrow = (T)value;
+        memcpy(bytes.data() + index * sizeof(T), &narrow, sizeof(T));
+    }
+
+    // Rewrites the stored values at a wider width (for push, so the bias stays 0)
+    void changeWidth(int newWidth) {
+        LargeVector<uint8_t> widened(std::max<size_t>(4096, count * 2 * newWidth));
+        withIdWidth(width, [&](auto oldType) {
+            withIdWidth(newWidth, [&](auto newType) {
+                using Old = decltype(oldType);
+                using New = decltype(newType);
+                for (size_t i = 0; i < count; ++i) {
+                    Old value;
+                    memcpy(&value, bytes.data() + i * sizeof(Old), sizeof(Old));
+                    New wide = (New)value;
+                    memcpy(widened.data() + i * sizeof(New), &wide, sizeof(New));
+                }
+            });
+        });
+        bytes.swap(widened);
+        setWidth(newWidth, 0);
+    }
+
+    void setWidth(int newWidth, int newBias) {
+        width = newWidth;
+        bias = newBias;
+        widthLimit = width == 1 ? UINT8_MAX : width == 2 ? UINT16_MAX : UINT32_MAX;
+    }
+
+    LargeVector<uint8_t> bytes; // count values of `width` bytes, then spare capacity
+    size_t count = 0;
+    int width = 1;
+    int bias = 0;                     // Stored value + bias is the value
+    uint32_t widthLimit = UINT8_MAX;  // Largest stored value of the current width
+};
+
+#endif // NARROW_IDS_H
@@ -0,0 +1,67 @@
+/*
+ * File Name: online_model.h
+ *
+ * Description:
+ * Adaptive token ranking for the online encoder (`project5 --online`) and its decoder
+ * (`project5_decompress --decode --online`). Both sides count every token as it goes by and
+ * re-sort the vocabulary with the same total order as the offline encoder (sortTokenIds) at
+ * the same points in the stream, so they always agree on the ranking without exchanging it.
+ *
+ * A token gets a position only at a rebuild; until then it is written as an escape followed by
+ * the token itself. The encoder rebuilds once the tokens seen since the last rebuild reach
+ * max(ONLINE_MIN_REBUILD_INTERVAL, vocabulary size), which keeps the sorting work amortized to
+ * O(log V) per token, and marks each rebuild in-band so the decoder does not need the schedule.
+ */
+
+#ifndef ONLINE_MODEL_H
+#define ONLINE_MODEL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+#include "token_table.h"
+
+// Fewest tokens between two rebuilds of the ranking
+const size_t ONLINE_MIN_REBUILD_INTERVAL = 1024;
+
+class OnlineRankModel {
+public:
+    // Counts one occurrence of the token and returns its id (tokens are copied into the model)
+    int observe(std::string_view token) {
+        ++sinceRebuild;
+        return counts.internCopy(token);
+    }
+
+    // Position of an id under the current ranking, or 0 if it is newer than the last rebuild
+    int positionOf(int id) const { return (size_t)id < idPosition.size() ? idPosition[id] : 0; }
+
+    // True once the encoder's schedule calls for a rebuild
+    bool rebuildDue() const { return sinceRebuild >= std::max(ONLINE_MIN_REBUILD_INTERVAL, counts.size()); }
+
+    // Re-ranks every token seen so far
+    void rebuild() {
+        std::vector<int> sortedIds = sortTokenIds(counts);
+        idPosition = buildPositionMap(sortedIds);
+        rankedTokens.clear();
+        for (int id : sortedIds) {
+            rankedTokens.push_back(counts.token(id));
+        }
+        sinceRebuild = 0;
+    }
+
+    // Tokens in the current ranking (position p is tokens()[p - 1])
+    const std::vector<std::string_view> &tokens() const { return rankedTokens; }
+
+    // Table of every token seen, indexed by the ids observe() returns
+    const TokenTable &table() const { return counts; }
+
+private:
+    TokenTable counts;
+    std::vector<int> idPosition;
+    std::vector<std::string_view> rankedTokens;
+    size_t sinceRebuild = 0;
+};
+
+#endif // ONLINE_MODEL_H
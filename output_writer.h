@@ -0,0 +1,202 @@
+/*
+ * File Name: output_writer.h
+ *
+ * Description:
+ * Buffered output stage shared by the programs. Text and integers are formatted straight into
+ * a 1 MiB buffer (integers with a two-digits-at-a-time itoa) and the buffer is handed to fwrite
+ * in large blocks, instead of going through iostream formatting and flushing per value.
+ * Output written through it is byte-for-byte what the equivalent `cout <<` calls produced.
+ *
+ * startBackgroundWrites() moves the fwrite calls to a writer thread (async_pipeline.h): a full
+ * buffer is queued and formatting goes on in a spare one, so output formatting and the write
+ * system calls overlap. flush() still returns only after everything has reached the stream.
+ */
+
+#ifndef OUTPUT_WRITER_H
+#define OUTPUT_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "async_pipeline.h"
+
+// Lookup table of the decimal digit pairs 00 to 99
+inline constexpr char DIGIT_PAIRS[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Formats the value in decimal at `destination` and returns the number of characters written
+// (at most 20, no terminator)
+inline size_t formatUnsigned(uint64_t value, char *destination) {
+    char digits[20];
+    char *end = digits + sizeof(digits);
+    char *cursor = end;
+    while (value >= 100) {
+        unsigned pair = (unsigned)(value % 100) * 2;
+        value /= 100;
+        cursor -= 2;
+        cursor[0] = DIGIT_PAIRS[pair];
+        cursor[1] = DIGIT_PAIRS[pair + 1];
+    }
+    if (value >= 10) {
+        unsigned pair = (unsigned)value * 2;
+        cursor -= 2;
+        cursor[0] = DIGIT_PAIRS[pair];
+        cursor[1] = DIGIT_PAIRS[pair + 1];
+    } else {
+        *--cursor = (char)('0' + value);
+    }
+    size_t length = (size_t)(end - cursor);
+    memcpy(destination, cursor, length);
+    return length;
+}
+
+class OutputWriter {
+public:
+    static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+    explicit OutputWriter(FILE *file = stdout) : file(file), buffer(BUFFER_SIZE) {}
+    OutputWriter(const OutputWriter &) = delete;
+    OutputWriter &operator=(const OutputWriter &) = delete;
+    ~OutputWriter() { flush(); }
+
+    // Switches the stream to binary mode where the platform distinguishes (no newline translation)
+    void setBinary() {
+#ifdef _WIN32
+        _setmode(_fileno(file), _O_BINARY);
+#endif
+    }
+
+    // Writes full buffers on a writer thread from now on, with up to `queueDepth` queued
+    void startBackgroundWrites(size_t queueDepth = 2) {
+        if (!background) {
+            background = std::make_unique<BlockWriterThread>(file, queueDepth);
+        }
+    }
+
+    void write(std::string_view text) {
+        if (text.size() > buffer.size() - used) {
+            spill();
+            if (text.size() > buffer.size() && !background) { // Too large to buffer, write it directly
+                writeBlock(text.data(), text.size());
+                return;
+            }
+            while (text.size() > buffer.size()) { // The writer thread takes it one buffer at a time
+                memcpy(buffer.data(), text.data(), buffer.size());
+                used = buffer.size();
+                text.remove_prefix(buffer.size());
+                spill();
+            }
+        }
+        memcpy(buffer.data() + used, text.data(), text.size());
+        used += text.size();
+    }
+
+    void put(char aChar) {
+        if (used == buffer.size()) {
+            spill();
+        }
+        buffer[used++] = aChar;
+    }
+
+    // Writes the value in decimal followed by `separator`
+    void writeNumber(uint64_t value, char separator) {
+        if (buffer.size() - used < 21) {
+            spill();
+        }
+        used += formatUnsigned(value, buffer.data() + used);
+        buffer[used++] = separator;
+    }
+
+    // Writes the value as 4 little-endian bytes
+    void writeUint32(uint32_t value) {
+        if (buffer.size() - used < 4) {
+            spill();
+        }
+        unsigned char *destination = (unsigned char *)buffer.data() + used;
+        destination[0] = (unsigned char)value;
+        destination[1] = (unsigned char)(value >> 8);
+        destination[2] = (unsigned char)(value >> 16);
+        destination[3] = (unsigned char)(value >> 24);
+        used += 4;
+    }
+
+    // Writes the value as 8 little-endian bytes
+    void writeUint64(uint64_t value) {
+        writeUint32((uint32_t)value);
+        writeUint32((uint32_t)(value >> 32));
+    }
+
+    // Writes the value as an LEB128 varint (7 bits per byte, high bit set on all but the last)
+    void writeVarint(uint64_t value) {
+        if (buffer.size() - used < 10) {
+            spill();
+        }
+        while (value >= 0x80) {
+            buffer[used++] = (char)(value | 0x80);
+            value >>= 7;
+        }
+        buffer[used++] = (char)value;
+    }
+
+    // Hands the buffered bytes to the stream; returns false if any write so far has failed
+    bool flush() {
+        if (background) {
+            spill();
+            if (!background->drain()) {
+                failed = true;
+            }
+        } else if (used > 0) {
+            writeBlock(buffer.data(), used);
+            used = 0;
+        }
+        if (fflush(file) != 0) {
+            failed = true;
+        }
+        return !failed;
+    }
+
+    bool ok() const { return !failed; }
+
+    // Total number of bytes written so far, including bytes still in the buffer
+    uint64_t bytesWritten() const { return flushedBytes + used; }
+
+private:
+    // Makes room in a full buffer: queues it for the writer thread, or flushes it
+    void spill() {
+        if (!background) {
+            flush();
+        } else if (used > 0) {
+            background->submit(buffer, used);
+            flushedBytes += used;
+            used = 0;
+        }
+    }
+
+    void writeBlock(const char *data, size_t length) {
+        if (fwrite(data, 1, length, file) != length) {
+            failed = true;
+        }
+        flushedBytes += length;
+    }
+
+    FILE *file;
+    std::vector<char> buffer;
+    size_t used = 0;
+    uint64_t flushedBytes = 0;
+    bool failed = false;
+    std::unique_ptr<BlockWriterThread> background; // Writer thread, after startBackgroundWrites()
+};
+
+#endif // OUTPUT_WRITER_H
@@ -0,0 +1,123 @@
+/*
+ * File Name: parallel_count.h
+ *
+ * Description:
+ * Multi-threaded frequency counting for a contiguous input buffer. The input is cut at
+ * delimiters (whitespace by default) into one chunk per thread, each thread tokenizes and
+ * interns its chunk into a thread-local TokenTable, and the local tables are then merged into
+ * one global table in chunk order. Because the final ranking is a total order on (frequency,
+ * token), the merged table sorts to exactly the same sortedTokens order as a serial count,
+ * whatever the thread count.
+ *
+ * Encoding reuses the same chunks: remapChunksParallel turns each chunk's narrow id array
+ * (narrow_ids.h) into positions in place, one thread per chunk, so the encoder needs no second
+ * array and the chunks are written out in input order.
+ */
+
+#ifndef PARALLEL_COUNT_H
+#define PARALLEL_COUNT_H
+
+#include <cstddef>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "memory_placement.h"
+#include "narrow_ids.h"
+#include "token_scanner.h"
+#include "token_table.h"
+
+// A piece of the input as [begin, end) byte offsets; chunks never split a token
+struct InputChunk {
+    size_t begin;
+    size_t end;
+};
+
+// Tokens of one chunk, counted by one thread
+struct ChunkCount {
+    TokenTable table;           // Thread-local intern table (views into the input)
+    NarrowIdArray tokenIds;     // Local provisional id of every token in the chunk
+    std::vector<int> globalIds; // Local provisional id -> id in the merged table
+};
+
+// Cuts the input into `chunkCount` chunks of roughly equal size, moving each cut forward to
+// the next delimiter so that no token straddles two chunks
+// Only the built-in TokenDelimiters sets are supported, as in StreamTokenizer; custom
+// CharacterDelimiters<...> sets work only with the single-buffer forEachToken<Policy>
+inline std::vector<InputChunk> splitInput(std::string_view input, size_t chunkCount,
+                                          TokenDelimiters delimiters = TokenDelimiters::Whitespace) {
+    const DelimiterTable &table = delimiterTable(delimiters);
+    std::vector<InputChunk> chunks;
+    size_t begin = 0;
+    for (size_t i = 1; i <= chunkCount; ++i) {
+        size_t end = i == chunkCount ? input.size() : input.size() / chunkCount * i;
+        if (end < begin) {
+            end = begin;
+        }
+        while (end < input.size() && !table.isDelimiter[(unsigned char)input[end]]) {
+            ++end;
+        }
+        chunks.push_back({begin, end});
+        begin = end;
+    }
+    return chunks;
+}
+
+// Runs task(i) for every chunk index, one thread per chunk (chunk 0 on the calling thread)
+// With --numa-local each task runs on the NUMA node of its chunk (memory_placement.h)
+template <typename ChunkTask>
+inline void runPerChunk(size_t chunkCount, ChunkTask task) {
+    auto placedTask = [task, chunkCount](size_t i) {
+        ChunkNodeBinding binding(i, chunkCount);
+        task(i);
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < chunkCount; ++i) {
+        workers.emplace_back(placedTask, i);
+    }
+    if (chunkCount > 0) {
+        placedTask(0);
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+// Counts every chunk on its own thread into the chunk's local table
+inline void countChunksParallel(std::string_view input, const std::vector<InputChunk> &chunks,
+                                std::vector<ChunkCount> &counts,
+                                TokenDelimiters delimiters = TokenDelimiters::Whitespace) {
+    counts.clear();
+    counts.resize(chunks.size());
+    runPerChunk(chunks.size(), [&](size_t i) {
+        ChunkCount &count = counts[i];
+        forEachToken(delimiters, input.data() + chunks[i].begin, chunks[i].end - chunks[i].begin,
+                     [&count](std::string_view token) { count.tokenIds.push(count.table.intern(token)); });
+    });
+}
+
+// Merges the local tables into the global table in chunk order and records, for every chunk,
+// the mapping from its local provisional ids to global ones
+inline void mergeChunkCounts(std::vector<ChunkCount> &counts, TokenTable &table) {
+    for (ChunkCount &count : counts) {
+        count.globalIds.resize(count.table.size());
+        for (size_t id = 0; id < count.table.size(); ++id) {
+            count.globalIds[id] = table.merge(count.table.token((int)id), count.table.idFrequency[id]);
+        }
+    }
+}
+
+// Replaces the local ids of every chunk with their positions in place, one thread per chunk
+// Chunk i then holds the positions of its slice of the input at the chunk's narrow width
+inline void remapChunksParallel(std::vector<ChunkCount> &counts, const std::vector<int> &idPosition) {
+    runPerChunk(counts.size(), [&](size_t i) {
+        ChunkCount &count = counts[i];
+        std::vector<int> localPosition(count.globalIds.size()); // Local id -> position
+        for (size_t id = 0; id < localPosition.size(); ++id) {
+            localPosition[id] = idPosition[count.globalIds[id]];
+        }
+        count.tokenIds.remap(localPosition);
+    });
+}
+
+#endif // PARALLEL_COUNT_H
@@ -0,0 +1,218 @@
+/*
+ * File Name: partial_counts.h
+ *
+ * Description:
+ * Partial token frequency tables for counting a corpus spread over several machines. Every node
+ * counts its shard with `project5 --counts-out FILE`, `project5_merge` merges the partial tables
+ * into one global ranking and saves it as a dictionary file (dictionary_file.h), and every node
+ * then encodes its shard with `project5 --dict-in` against that same dictionary. Only token
+ * counts travel between machines, never the raw text.
+ *
+ * A table is sorted by token bytes, so any number of tables are merged in one k-way pass with
+ * one token of each table in memory, and the tokens are front coded (each stores how many bytes
+ * it shares with the previous token and only the rest):
+ *
+ *   magic          4 bytes "P5PC"
+ *   version        4 bytes (PARTIAL_COUNTS_VERSION)
+ *   tokenCount     8 bytes, number of distinct tokens
+ *   occurrences    8 bytes, sum of the counts
+ *   entries        tokenCount entries of varint sharedBytes, varint suffixLength, the suffix bytes
+ *                  and varint count, in strictly increasing token order
+ *
+ * Counts are added up in 64 bits, and the merged ranking uses the same total order as the
+ * encoder (count descending, then token bytes), so merging the tables of a split corpus gives
+ * exactly the dictionary that `--dict-out` saves for the whole corpus.
+ */
+
+#ifndef PARTIAL_COUNTS_H
+#define PARTIAL_COUNTS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "encoded_format.h"
+#include "mapped_file.h"
+#include "output_writer.h"
+#include "token_table.h"
+
+inline constexpr char PARTIAL_COUNTS_MAGIC[4] = {'P', '5', 'P', 'C'};
+const uint32_t PARTIAL_COUNTS_VERSION = 1;
+const size_t PARTIAL_COUNTS_HEADER_SIZE = 24; // Magic, version, tokenCount and occurrences
+
+// Ids of the table's tokens in increasing byte order (the order of a partial table)
+inline std::vector<int> sortTokenIdsByBytes(const TokenTable &table) {
+    std::vector<int> ids(table.size());
+    for (size_t id = 0; id < ids.size(); ++id) {
+        ids[id] = (int)id;
+    }
+    std::sort(ids.begin(), ids.end(), [&table](int a, int b) { return table.token(a) < table.token(b); });
+    return ids;
+}
+
+// Writes a partial table; `tokens` must be in strictly increasing byte order
+template <typename TokenList>
+bool writePartialCounts(const std::string &path, const TokenList &tokens, const std::vector<uint64_t> &counts,
+                        std::string &errorMessage) {
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        errorMessage = "Could not create '" + path + "'.";
+        return false;
+    }
+    uint64_t occurrences = 0;
+    for (uint64_t count : counts) {
+        occurrences += count;
+    }
+    {
+        OutputWriter writer(file);
+        writer.write(std::string_view(PARTIAL_COUNTS_MAGIC, sizeof(PARTIAL_COUNTS_MAGIC)));
+        writer.writeUint32(PARTIAL_COUNTS_VERSION);
+        writer.writeUint64(tokens.size());
+        writer.writeUint64(occurrences);
+        std::string_view previous;
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            std::string_view token = tokens[i];
+            size_t shared = 0;
+            size_t limit = std::min(previous.size(), token.size());
+            while (shared < limit && previous[shared] == token[shared]) {
+                ++shared;
+            }
+            writer.writeVarint(shared);
+            writer.writeVarint(token.size() - shared);
+            writer.write(token.substr(shared));
+            writer.writeVarint(counts[i]);
+            previous = token;
+        }
+        if (!writer.flush()) {
+            errorMessage = "Failed to write '" + path + "'.";
+        }
+    }
+    if (fclose(file) != 0 && errorMessage.empty()) {
+        errorMessage = "Failed to write '" + path + "'.";
+    }
+    return errorMessage.empty();
+}
+
+// Sequential reader of a memory-mapped partial table
+class PartialCountsReader {
+public:
+    bool open(const std::string &path, std::string &errorMessage) {
+        if (!file.open(path, errorMessage)) {
+            return false;
+        }
+        this->path = path;
+        std::string_view data = file.view();
+        if (data.size() < PARTIAL_COUNTS_HEADER_SIZE ||
+            data.substr(0, sizeof(PARTIAL_COUNTS_MAGIC)) !=
+                std::string_view(PARTIAL_COUNTS_MAGIC, sizeof(PARTIAL_COUNTS_MAGIC))) {
+            errorMessage = "'" + path + "' is not a partial count table.";
+            return false;
+        }
+        uint32_t version = loadUint32(data.data() + 4);
+        if (version != PARTIAL_COUNTS_VERSION) {
+            errorMessage = "'" + path + "' has unsupported partial count table version " + std::to_string(version) + ".";
+            return false;
+        }
+        tokenCount = loadUint64(data.data() + 8);
+        occurrences = loadUint64(data.data() + 16);
+        reader = ByteReader(data, PARTIAL_COUNTS_HEADER_SIZE);
+        return true;
+    }
+
+    // Number of distinct tokens and the sum of their counts
+    uint64_t size() const { return tokenCount; }
+    uint64_t occurrenceCount() const { return occurrences; }
+
+    // Reads the next entry; the token view is valid until the following call
+    // Returns false at the end of the table, with a message if the table is corrupt
+    bool next(std::string_view &token, uint64_t &count, std::string &errorMessage) {
+        if (readCount == tokenCount) {
+            if (reader.remaining() != 0 || countSum != occurrences) {
+                errorMessage = "'" + path + "' is truncated or corrupt.";
+            }
+            return false;
+        }
+        uint64_t shared, suffixLength;
+        std::string_view suffix;
+        if (!reader.readVarint(shared) || shared > current.size() || !reader.readVarint(suffixLength) ||
+            !reader.readBytes(suffixLength, suffix) || !reader.readVarint(count)) {
+            errorMessage = "Corrupt entry " + std::to_string(readCount) + " in '" + path + "'.";
+            return false;
+        }
+        previous.assign(current);
+        current.resize((size_t)shared);
+        current.append(suffix.data(), suffix.size());
+        if (readCount > 0 && !(previous < current)) {
+            errorMessage = "'" + path + "' is not sorted at entry " + std::to_string(readCount) + ".";
+            return false;
+        }
+        ++readCount;
+        countSum += count;
+        token = current;
+        return true;
+    }
+
+private:
+    MappedFile file;
+    std::string path;
+    ByteReader reader{std::string_view()};
+    uint64_t tokenCount = 0;
+    uint64_t occurrences = 0;
+    uint64_t readCount = 0;
+    uint64_t countSum = 0; // Checked against `occurrences` at the end
+    std::string current;  // Token of the last entry read
+    std::string previous; // Token before it, for the order check
+};
+
+// Merges sorted partial tables in one k-way pass; onToken(token, count) is called once per
+// distinct token in increasing byte order, with the counts of all tables added up
+// Returns false with a message if a table is corrupt
+template <typename TokenCallback>
+bool mergePartialCounts(std::vector<PartialCountsReader> &tables, TokenCallback &&onToken,
+                        std::string &errorMessage) {
+    struct Head {
+        std::string_view token;
+        uint64_t count;
+        size_t table;
+    };
+    auto later = [](const Head &a, const Head &b) { return a.token > b.token; };
+    std::priority_queue<Head, std::vector<Head>, decltype(later)> heads(later);
+    for (size_t i = 0; i < tables.size(); ++i) {
+        Head head{std::string_view(), 0, i};
+        if (tables[i].next(head.token, head.count, errorMessage)) {
+            heads.push(head);
+        } else if (!errorMessage.empty()) {
+            return false;
+        }
+    }
+    std::string token; // Copied, since advancing a table overwrites its view
+    while (!heads.empty()) {
+        Head head = heads.top();
+        heads.pop();
+        token.assign(head.token.data(), head.token.size());
+        uint64_t count = head.count;
+        while (true) {
+            if (tables[head.table].next(head.token, head.count, errorMessage)) {
+                heads.push(head);
+            } else if (!errorMessage.empty()) {
+                return false;
+            }
+            if (heads.empty() || heads.top().token != token) {
+                break;
+            }
+            head = heads.top(); // The same token in another table
+            heads.pop();
+            count += head.count;
+        }
+        onToken(std::string_view(token), count);
+    }
+    return true;
+}
+
+#endif // PARTIAL_COUNTS_H
@@ -17,115 +17,859 @@
  * - Sorting tokens based on frequency and lexicographical order
  * - Encoding the original text into positional representations
  * 
+ * Usage:
+ *   project5 < input.txt            Buffer the whole input and encode it (default)
+ *   project5 input.txt              Memory-map the file and tokenize it in place
+ *   project5 --stream < input.txt   Stream the input in chunks; only the vocabulary stays resident
+ *   project5 --threads N input.txt  Count and encode on N threads (same output as serial)
+ *   project5 --raw-ids < input.txt  Write the positions as 4-byte little-endian integers
+ *   project5 --binary < input.txt   Write the binary container (encoded_format.h) instead of text
+ *   project5 --framed < input.txt   Binary container cut into indexed 64K-token frames
+ *                                   (--frame-size N changes the frame length)
+ *   project5 --huffman < input.txt  Binary container with Huffman-coded positions (combines with --framed)
+ *   project5 --dict-out FILE < a.txt  Also save the sorted dictionary to FILE (dictionary_file.h)
+ *   project5 --dict-in FILE < b.txt   Encode in one pass against a saved dictionary; tokens missing
+ *                                     from it are written as an escape (0) followed by the token
+ *   project5 --top-k K < input.txt   Rank only the K most frequent tokens; the rest are written as an
+ *                                     escape (0) followed by the token (combines with any format)
+ *   project5 --online < live.log     Encode tokens as they arrive with an adaptive ranking (text only;
+ *                                     decode with `project5_decompress --decode --online`)
+ *   project5 --batch LIST --threads N Encode every file listed in LIST (one path per line) to
+ *                                     path.enc on a work-stealing pool of N threads (combines with the
+ *                                     format options and with a shared --dict-in dictionary)
+ *   project5 --lossless < input.txt  Binary container that also keeps the whitespace between tokens, so
+ *                                     decoding restores the input byte for byte (combines with
+ *                                     --huffman and --top-k; counts on one thread)
+ *   project5 --binary --delimiters csv < data.csv
+ *                                    Split tokens on ',' and newlines instead of whitespace (`pipe`
+ *                                     splits on '|' and newlines, for log fields); binary containers
+ *                                     only, since their dictionary can hold tokens with spaces
+ *   project5 --counts-out FILE < shard.txt
+ *                                    Only count the input and save the partial frequency table
+ *                                     (partial_counts.h); `project5_merge` merges the tables of
+ *                                     several machines into a dictionary for --dict-in
+ *   project5 --store-counts < input.txt
+ *                                    Binary container that also stores the count of every dictionary
+ *                                     token, so `project5_query --count` answers without a scan
+ *                                     (combines with the other binary options)
+ *   project5 --huge-pages transparent --threads N < big.txt
+ *                                    Back the input buffer, token tables and id arrays with huge
+ *                                     pages (`explicit` uses the hugetlbfs pool and falls back to
+ *                                     transparent pages when it is empty; `off` is the default)
+ *   project5 --numa-local --threads N < big.txt
+ *                                    Run each chunk thread on one NUMA node and place its slice of
+ *                                     the input, table and ids there (no effect on one node)
+ *   project5 --stats < input.txt     Also write stage times and table counters as JSON to stderr
+ *                                     (stage_stats.h; build with -DP5_NO_STATS to compile them out)
+ * 
+ * Build: g++ -std=c++17 -O2 -pthread project5.cpp -o project5
+ *        (add -lpsapi when building with MinGW on Windows)
+ * 
  * Full code documentation and LLM and AI assistance details are provided at the end of the code.
  */
 
 #include <iostream>
 #include <string>
-#include <unordered_map>
-#include <map>
+#include <string_view>
 #include <vector>
 #include <algorithm>
-#include <cctype>
-#include <sstream>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "async_pipeline.h"
+#include "dictionary_file.h"
+#include "encoded_format.h"
+#include "mapped_file.h"
+#include "memory_placement.h"
+#include "narrow_ids.h"
+#include "online_model.h"
+#include "output_writer.h"
+#include "parallel_count.h"
+#include "partial_counts.h"
+#include "separator_stream.h"
+#include "stage_stats.h"
+#include "text_codec.h"
+#include "token_scanner.h"
+#include "token_table.h"
+#include "work_pool.h"
 
 using namespace std;
 
-// Helper function to add tokens to the frequency map
-// This function increments the frequency count for a given token in the map
-void addToken(unordered_map<string, int> &tokenFrequency, const string &token) {
-    if (!token.empty()) {
-        tokenFrequency[token]++;
+// Size of each read from standard input in streaming mode
+const size_t STREAM_CHUNK_SIZE = 1 << 20;
+
+// Number of token ids buffered in memory before they are spilled to the temporary file
+const size_t SPILL_BLOCK_SIZE = 1 << 16;
+
+// Helper function to write a block of provisional ids to the spill file
+bool spillIds(FILE *spillFile, vector<int> &idBlock, size_t &spilledIdCount) {
+    if (!idBlock.empty() && fwrite(idBlock.data(), sizeof(int), idBlock.size(), spillFile) != idBlock.size()) {
+        cerr << "Error: Failed to write to temporary spill file." << endl;
+        return false;
+    }
+    spilledIdCount += idBlock.size();
+    idBlock.clear();
+    return true;
+}
+
+// Helper function to index a saved dictionary for --dict-in
+// Token rank r gets id r, so a token found in `ranks` has position id + 1
+void indexDictionary(const DictionaryFile &dictionary, TokenTable &ranks) {
+    ranks.tokenIds.reserve(dictionary.size(), ranks.idTokens);
+    for (size_t rank = 0; rank < dictionary.size(); ++rank) {
+        ranks.intern(dictionary.token(rank)); // Views into the mapped dictionary file
+    }
+}
+
+// Helper function to finish the encoded output and report write errors
+int finishEncodedOutput(EncodedOutput &output) {
+    if (!output.finish()) {
+        cerr << "Error: Failed to write the encoded output." << endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Helper function to save the sorted dictionary and its counts for later --dict-in runs
+bool saveDictionary(const string &path, const TokenTable &table, const vector<int> &sortedIds) {
+    STATS_TIMER("save_dictionary");
+    vector<string_view> tokens;
+    vector<uint64_t> counts;
+    tokens.reserve(sortedIds.size());
+    counts.reserve(sortedIds.size());
+    for (int id : sortedIds) {
+        tokens.push_back(table.token(id));
+        counts.push_back((uint64_t)table.idFrequency[id]);
     }
+    string errorMessage;
+    if (!writeDictionaryFile(path, tokens, counts, errorMessage)) {
+        cerr << "Error: " << errorMessage << endl;
+        return false;
+    }
+    return true;
 }
 
-// Function to process tokens and encode text
-// Looks up a token's position in the tokenPosition map and appends it to the encodedText vector
-void processToken(const map<string, int> &tokenPosition, const string &token, vector<int> &encodedText) {
-    if (!token.empty()) {
-        auto it = tokenPosition.find(token);
-        if (it != tokenPosition.end()) {
-            encodedText.push_back(it->second); // Add the token's position to the encoded text
+// Streaming encoder
+// Reads standard input in fixed-size chunks so the raw text is never resident as a whole; a
+// reader thread fetches the next chunks while the current one is tokenized (async_pipeline.h).
+// Pass one interns every token into a provisional id and spills the id sequence to a temporary
+// file; pass two replays the spilled ids through the provisional-id-to-position remap array.
+// Without `spill` (standard input without --stream) the id sequence stays in memory instead.
+int encodeStreaming(const OutputOptions &options, const string &dictionaryOutPath, bool spill) {
+    FILE *spillFile = nullptr;
+    if (spill && (spillFile = tmpfile()) == nullptr) {
+        cerr << "Error: Could not create temporary spill file." << endl;
+        return 1;
+    }
+
+    // Step 1 and 2: Read chunks and intern tokens, spilling the provisional id sequence
+    TokenTable table;
+    vector<int> idBlock; // Ids waiting to be spilled
+    NarrowIdArray ids;   // Without `spill`: every id, at the narrowest width (narrow_ids.h)
+    if (spill) {
+        idBlock.reserve(SPILL_BLOCK_SIZE);
+    }
+    StreamTokenizer tokenizer(options.delimiters); // Carries tokens across chunk boundaries
+    auto onToken = [&](string_view token) {
+        int id = table.internCopy(token); // The chunk is reused, so new tokens are copied
+        if (spill) {
+            idBlock.push_back(id);
         } else {
-            cerr << "Error: Token '" << token << "' not found in tokenPosition map." << endl;
+            ids.push(id);
+        }
+    };
+    size_t spilledIdCount = 0; // Total number of tokens, needed by the binary header
+
+    {
+        STATS_TIMER("read_count");
+        ChunkReader reader(stdin, STREAM_CHUNK_SIZE);
+        string_view chunk;
+        while (reader.next(chunk)) {
+            STATS_ADD("bytes_read", chunk.size());
+            tokenizer.feed(chunk.data(), chunk.size(), onToken);
+            if (spill && idBlock.size() >= SPILL_BLOCK_SIZE && !spillIds(spillFile, idBlock, spilledIdCount)) {
+                fclose(spillFile);
+                return 1;
+            }
+        }
+        tokenizer.finish(onToken); // Process the last token if present
+        if (reader.failed()) {
+            cerr << "Error: Failed to read standard input." << endl;
+            if (spill) {
+                fclose(spillFile);
+            }
+            return 1;
+        }
+        if (!spill) {
+            spilledIdCount = ids.size();
+        } else if (!spillIds(spillFile, idBlock, spilledIdCount)) {
+            fclose(spillFile);
+            return 1;
         }
     }
+    STATS_ADD("tokens", spilledIdCount);
+    STATS_TABLE(table);
+
+    // Step 3 and 4: Sort the vocabulary and turn provisional ids into positions
+    vector<int> idPosition;
+    vector<int> sortedIds;
+    {
+        STATS_TIMER("sort");
+        sortedIds = rankTokens(table, options.topK, 1, idPosition);
+    }
+    if (!dictionaryOutPath.empty() && !saveDictionary(dictionaryOutPath, table, sortedIds)) {
+        if (spill) {
+            fclose(spillFile);
+        }
+        return 1;
+    }
+
+    // Step 5: Output the unique tokens in sorted order
+    EncodedOutput output(options);
+    output.setLiterals(table); // Long tail tokens of --top-k
+    {
+        STATS_TIMER("write_dictionary");
+        output.writeDictionary(table, sortedIds, spilledIdCount);
+    }
+
+    // Step 6: Replay the spilled ids and output their positions
+    STATS_TIMER("encode_write");
+    if (!spill) {
+        ids.remap(idPosition);
+        STATS_ADD("position_bytes", ids.memoryBytes());
+        output.writePositions(ids);
+        return finishEncodedOutput(output);
+    }
+    rewind(spillFile);
+    idBlock.resize(SPILL_BLOCK_SIZE);
+    size_t idCount;
+    while ((idCount = fread(idBlock.data(), sizeof(int), idBlock.size(), spillFile)) > 0) {
+        for (size_t i = 0; i < idCount; ++i) {
+            idBlock[i] = idPosition[idBlock[i]];
+        }
+        output.writePositions(idBlock.data(), idCount);
+    }
+
+    fclose(spillFile);
+    return finishEncodedOutput(output);
 }
 
-int main() {
-    // Step 1: Read all input from standard input into a single string
-    // This approach allows the program to handle redirected input seamlessly
-    string inputContent((istreambuf_iterator<char>(cin)), istreambuf_iterator<char>());
-
-    // Step 2: Calculate token frequencies
-    // Parse the input content to count occurrences of each token
-    unordered_map<string, int> tokenFrequency; // Map to store token frequencies
-    string token; // Current token being processed
-    char aChar; // Current character being read
-
-    istringstream inputStream(inputContent); // Create a stream from the input content
-    while (inputStream.get(aChar)) {
-        if (isspace(aChar)) { // If the character is a space, process the current token
-            addToken(tokenFrequency, token);
-            token.clear(); // Reset the token for the next word
-        } else {
-            token += aChar; // Append the character to the current token
+// Single-pass encoder for --dict-in
+// The ranking comes from the saved dictionary, so there is nothing to count or sort: each token
+// is looked up once and becomes its saved position, or an escape when the dictionary does not
+// contain it. Text formats are written as the input is read. The binary header needs the token
+// count first, so binary positions are held back (spilled to a temporary file when streaming).
+// `ranks` is the dictionary indexed by indexDictionary; it is only read, so threads can share it
+int encodeWithDictionary(const OutputOptions &options, const DictionaryFile &dictionary, const TokenTable &ranks,
+                         TokenTable &literals, string_view input, bool streamInput) {
+    EncodedOutput output(options);
+    output.setLiterals(literals);
+    bool holdPositions = options.format == OutputFormat::Binary;
+    if (!holdPositions) {
+        output.writeExternalDictionary(dictionary, 0);
+    }
+
+    // Step 1: Encode every token with one lookup
+    STATS_TIMER("encode_write");
+    vector<int> idBlock;
+    idBlock.reserve(SPILL_BLOCK_SIZE);
+    FILE *spillFile = nullptr;
+    size_t spilledIdCount = 0;
+    bool spillFailed = false;
+    auto onToken = [&](string_view token) {
+        int id = ranks.find(token);
+        idBlock.push_back(id >= 0 ? id + 1 : -(literals.internCopy(token) + 1));
+        if (idBlock.size() < SPILL_BLOCK_SIZE || (holdPositions && !streamInput) || spillFailed) {
+            return;
+        }
+        if (!holdPositions) {
+            output.writePositions(idBlock.data(), idBlock.size());
+            idBlock.clear();
+        } else if (!spillIds(spillFile, idBlock, spilledIdCount)) {
+            spillFailed = true;
         }
+    };
+    if (streamInput) {
+        if (holdPositions && (spillFile = tmpfile()) == nullptr) {
+            cerr << "Error: Could not create temporary spill file." << endl;
+            return 1;
+        }
+        ChunkReader reader(stdin, STREAM_CHUNK_SIZE); // Reads ahead while the chunk is encoded
+        StreamTokenizer tokenizer(options.delimiters);
+        string_view chunk;
+        while (!spillFailed && reader.next(chunk)) {
+            STATS_ADD("bytes_read", chunk.size());
+            tokenizer.feed(chunk.data(), chunk.size(), onToken);
+        }
+        tokenizer.finish(onToken);
+        reader.stop(); // A spill error leaves the loop with the reader still running
+        if (reader.failed()) {
+            cerr << "Error: Failed to read standard input." << endl;
+            if (spillFile != nullptr) {
+                fclose(spillFile);
+            }
+            return 1;
+        }
+    } else {
+        forEachToken(options.delimiters, input.data(), input.size(), onToken);
     }
-    addToken(tokenFrequency, token); // Process the last token if present
+    STATS_ADD("tokens", spilledIdCount + idBlock.size());
+    STATS_ADD("dictionary_misses", literals.size());
 
-    // Step 3: Transfer data to a vector for sorting
-    // Move the token-frequency pairs to a vector and sort them
-    vector<pair<string, int>> sortedTokens(tokenFrequency.begin(), tokenFrequency.end());
-    sort(sortedTokens.begin(), sortedTokens.end(),
-         [](const pair<string, int> &a, const pair<string, int> &b) {
-             if (a.second != b.second) {
-                 return a.second > b.second; // Sort by frequency (descending)
-             }
-             return a.first < b.first; // Lexicographical order for tie-breaking
-         });
+    // Step 2: Output the held back binary positions behind the header
+    if (spillFile != nullptr) {
+        if (spillFailed || !spillIds(spillFile, idBlock, spilledIdCount)) {
+            fclose(spillFile);
+            return 1;
+        }
+        output.writeExternalDictionary(dictionary, spilledIdCount);
+        rewind(spillFile);
+        idBlock.resize(SPILL_BLOCK_SIZE);
+        size_t idCount;
+        while ((idCount = fread(idBlock.data(), sizeof(int), idBlock.size(), spillFile)) > 0) {
+            output.writePositions(idBlock.data(), idCount);
+        }
+        fclose(spillFile);
+        return finishEncodedOutput(output);
+    }
+    if (holdPositions) {
+        output.writeExternalDictionary(dictionary, idBlock.size());
+    }
+    output.writePositions(idBlock.data(), idBlock.size());
+    return finishEncodedOutput(output);
+}
 
-    // Step 4: Map tokens to their positions in the sorted order
-    // Create a map that associates each token with its position in the sorted list
-    map<string, int> tokenPosition;
-    int position = 1; // Positions start at 1
-    for (const auto &pair : sortedTokens) {
-        tokenPosition[pair.first] = position++;
+// Encoder for one input buffer (a mapped file or the buffered standard input)
+// With threadCount > 1 the counting and encoding passes run on whitespace-aligned chunks;
+// --lossless records the separator runs in the same tokenizer pass, on one thread
+int encodeBuffer(string_view input, const OutputOptions &options, size_t threadCount, EncoderWorkspace &workspace,
+                 const string &dictionaryOutPath) {
+    if (options.lossless) {
+        threadCount = 1;
+    }
+
+    // Step 2: Tokenize once, interning each token and recording its provisional id
+    // Tokens are views into the input buffer, so no token strings are allocated while counting
+    {
+        STATS_TIMER("count");
+        workspace.count(input, threadCount, options.delimiters, options.lossless);
+    }
+    STATS_TABLE(workspace.table);
+
+    // Step 3 and 4: Sort the provisional ids and map them to their positions in the sorted order
+    // Order by frequency (descending) and lexicographically for tie-breaking; a flat remap
+    // array replaces the token-to-position map
+    vector<int> idPosition;
+    vector<int> sortedIds;
+    {
+        STATS_TIMER("sort");
+        sortedIds = rankTokens(workspace.table, options.topK, threadCount, idPosition);
+    }
+    if (!dictionaryOutPath.empty() && !saveDictionary(dictionaryOutPath, workspace.table, sortedIds)) {
+        return 1;
     }
 
     // Step 5: Output the unique tokens in sorted order
-    // Print the sorted tokens as a single space-separated line
-    for (const auto &pair : sortedTokens) {
-        cout << pair.first << " ";
+    size_t idCount = workspace.idCount();
+    STATS_ADD("tokens", idCount);
+    EncodedOutput output(options);
+    output.setLiterals(workspace.table); // Long tail tokens of --top-k
+    if (options.lossless) {
+        output.setSeparators(workspace.separators);
+    }
+    {
+        STATS_TIMER("write_dictionary");
+        output.writeDictionary(workspace.table, sortedIds, idCount);
     }
-    cout << endl << "**********" << endl;
 
     // Step 6: Encode the text based on token positions
-    // Parse the input content again and encode tokens into their corresponding positions
-    vector<int> encodedText; // Vector to store the encoded text
-    token.clear(); // Reset token for the second pass
-
-    istringstream secondPass(inputContent); // Reuse the stored input content
-    while (secondPass.get(aChar)) {
-        if (isspace(aChar)) { // If the character is a space, process the current token
-            processToken(tokenPosition, token, encodedText);
-            token.clear(); // Reset the token for the next word
-        } else {
-            token += aChar; // Append the character to the current token
-        }
+    // Remap the recorded provisional ids in place instead of tokenizing the input again; the
+    // positions keep the narrow width of the ids (narrow_ids.h)
+    {
+        STATS_TIMER("encode");
+        workspace.remap(idPosition); // Parallel mode: each thread remaps its own chunk
+    }
+    STATS_ADD("position_bytes", workspace.positionBytes());
+    if (memoryPolicy().active()) {
+        STATS_ADD("large_region_bytes", memoryPolicy().takeMappedBytes());
+        STATS_ADD("huge_page_fallbacks", memoryPolicy().takeExplicitFallbacks());
     }
-    processToken(tokenPosition, token, encodedText); // Process the last token if present
 
     // Output the encoded text
     // Print the encoded text as a single space-separated line
-    for (int position : encodedText) {
-        cout << position << " ";
+    STATS_TIMER("write_positions");
+    workspace.writePositions(output); // Parallel mode: the chunks in input order
+    return finishEncodedOutput(output);
+}
+
+// Batch encoder
+// Encodes every file named in the list (one path per line) to the same path plus ".enc".
+// Files are scheduled on a work-stealing pool; each worker reuses one EncoderWorkspace for all
+// the files it encodes. Every output has its own dictionary unless a shared saved dictionary
+// is given (`dictionary` is non-null, with `ranks` indexing it).
+int encodeBatch(const string &listPath, const OutputOptions &options, size_t threadCount,
+                const DictionaryFile *dictionary, const TokenTable &ranks) {
+    MappedFile listFile;
+    string errorMessage;
+    if (!listFile.open(listPath, errorMessage)) {
+        cerr << "Error: " << errorMessage << endl;
+        return 1;
+    }
+    vector<string> inputPaths;
+    string_view list = listFile.view();
+    while (!list.empty()) {
+        size_t lineEnd = min(list.find('\n'), list.size());
+        string_view path = list.substr(0, lineEnd);
+        if (!path.empty() && path.back() == '\r') {
+            path.remove_suffix(1);
+        }
+        if (!path.empty()) {
+            inputPaths.emplace_back(path);
+        }
+        list.remove_prefix(min(lineEnd + 1, list.size()));
     }
-    cout << endl;
 
+    vector<EncoderWorkspace> workspaces(workerCountFor(inputPaths.size(), threadCount));
+    vector<string> fileErrors(inputPaths.size()); // Reported after the pool finishes
+    runWorkStealing(inputPaths.size(), threadCount, [&](size_t worker, size_t index) {
+        const string &inputPath = inputPaths[index];
+        MappedFile mappedInput;
+        if (!mappedInput.open(inputPath, fileErrors[index])) {
+            return;
+        }
+        string outputPath = inputPath + ".enc";
+        FILE *outputFile = fopen(outputPath.c_str(), "wb");
+        if (outputFile == nullptr) {
+            fileErrors[index] = "Could not create '" + outputPath + "'.";
+            return;
+        }
+        STATS_ADD("bytes_read", mappedInput.view().size());
+        OutputOptions fileOptions = options;
+        fileOptions.destination = outputFile;
+        fileOptions.backgroundWrites = false; // The other workers already overlap with the writes
+        EncoderWorkspace &workspace = workspaces[worker];
+        workspace.clear();
+        int status = dictionary != nullptr
+                         ? encodeWithDictionary(fileOptions, *dictionary, ranks, workspace.literals,
+                                                mappedInput.view(), false)
+                         : encodeBuffer(mappedInput.view(), fileOptions, 1, workspace, string());
+        if (fclose(outputFile) != 0 || status != 0) {
+            fileErrors[index] = "Failed to write '" + outputPath + "'.";
+        }
+    });
+
+    int failedCount = 0;
+    for (const string &fileError : fileErrors) {
+        if (!fileError.empty()) {
+            cerr << "Error: " << fileError << endl;
+            ++failedCount;
+        }
+    }
+    return failedCount == 0 ? 0 : 1;
+}
+
+// Counting pass for --counts-out
+// Counts a mapped file (on `threadCount` threads) or standard input chunk by chunk and saves
+// the partial frequency table instead of encoding, to be merged with other machines' tables
+int countToPartialTable(const string &inputPath, const OutputOptions &options, size_t threadCount,
+                        const string &countsOutPath) {
+    // Step 1 and 2: Read and count the input
+    TokenTable table;
+    MappedFile mappedInput;
+    vector<ChunkCount> chunkCounts;
+    {
+        STATS_TIMER("read_count");
+        if (inputPath.empty()) {
+            ChunkReader reader(stdin, STREAM_CHUNK_SIZE);
+            StreamTokenizer tokenizer(options.delimiters);
+            auto onToken = [&table](string_view token) { table.internCopy(token); };
+            string_view chunk;
+            while (reader.next(chunk)) {
+                STATS_ADD("bytes_read", chunk.size());
+                tokenizer.feed(chunk.data(), chunk.size(), onToken);
+            }
+            tokenizer.finish(onToken);
+            if (reader.failed()) {
+                cerr << "Error: Failed to read standard input." << endl;
+                return 1;
+            }
+        } else {
+            string errorMessage;
+            if (!mappedInput.open(inputPath, errorMessage)) {
+                cerr << "Error: " << errorMessage << endl;
+                return 1;
+            }
+            string_view input = mappedInput.view();
+            STATS_ADD("bytes_read", input.size());
+            if (threadCount > 1) {
+                countChunksParallel(input, splitInput(input, threadCount, options.delimiters), chunkCounts,
+                                    options.delimiters);
+                mergeChunkCounts(chunkCounts, table);
+            } else {
+                forEachToken(options.delimiters, input.data(), input.size(),
+                             [&table](string_view token) { table.intern(token); });
+            }
+        }
+    }
+    STATS_TABLE(table);
+
+    // Step 3: Save the counts in token byte order
+    STATS_TIMER("save_counts");
+    vector<int> sortedIds = sortTokenIdsByBytes(table);
+    vector<string_view> tokens;
+    vector<uint64_t> counts;
+    tokens.reserve(sortedIds.size());
+    counts.reserve(sortedIds.size());
+    for (int id : sortedIds) {
+        tokens.push_back(table.token(id));
+        counts.push_back((uint64_t)table.idFrequency[id]);
+    }
+    string errorMessage;
+    if (!writePartialCounts(countsOutPath, tokens, counts, errorMessage)) {
+        cerr << "Error: " << errorMessage << endl;
+        return 1;
+    }
     return 0;
 }
 
+// Helper function to read whatever standard input has available, up to `capacity` bytes
+// Unlike cin.read it returns as soon as some data arrives, so a live input is not held back
+// until a whole chunk fills up. Returns 0 at end of input.
+size_t readAvailable(char *buffer, size_t capacity) {
+#ifdef _WIN32
+    int count = _read(0, buffer, (unsigned)capacity);
+#else
+    ssize_t count;
+    do {
+        count = read(STDIN_FILENO, buffer, capacity);
+    } while (count < 0 && errno == EINTR);
+#endif
+    return count > 0 ? (size_t)count : 0;
+}
+
+// Online encoder (--online)
+// Tokens are encoded as soon as they are read, under a ranking that adapts as the input goes
+// (online_model.h). A token that has no position yet is written as an escape followed by the
+// token, and every rebuild of the ranking is marked with "-" so the decoder rebuilds at the
+// same point. The output is flushed after every read, so the delay from input to encoded
+// output is one read rather than the whole file.
+int encodeOnline(const OutputOptions &options) {
+    STATS_TIMER("encode_write");
+    OnlineRankModel model;
+    EncodedOutput output(options);
+    output.setLiterals(model.table()); // Escape -(id + 1) writes the token with that model id
+    output.writeOnlineHeader();
+
+    vector<int> block; // Values of the tokens encoded since the last write
+    vector<char> chunk(STREAM_CHUNK_SIZE);
+    StreamTokenizer tokenizer;
+    size_t tokenCount = 0;
+    auto onToken = [&](string_view token) {
+        ++tokenCount;
+        int id = model.observe(token);
+        int position = model.positionOf(id);
+        block.push_back(position > 0 ? position : -(id + 1));
+        if (model.rebuildDue()) {
+            output.writePositions(block.data(), block.size());
+            block.clear();
+            output.writeRebuildMarker();
+            STATS_ADD("rank_rebuilds", 1);
+            model.rebuild();
+        }
+    };
+    size_t chunkLength;
+    while ((chunkLength = readAvailable(chunk.data(), chunk.size())) > 0) {
+        STATS_ADD("bytes_read", chunkLength);
+        tokenizer.feed(chunk.data(), chunkLength, onToken);
+        output.writePositions(block.data(), block.size());
+        block.clear();
+        if (!output.flush()) {
+            cerr << "Error: Failed to write the encoded output." << endl;
+            return 1;
+        }
+    }
+    tokenizer.finish(onToken);
+    output.writePositions(block.data(), block.size());
+    STATS_ADD("tokens", tokenCount);
+    STATS_TABLE(model.table());
+    return finishEncodedOutput(output);
+}
+
+// Helper function to read standard input into a buffer that follows the memory policy
+// A regular file is sized first and each chunk thread reads its own slice into place, so with
+// --numa-local every slice is first touched on the node of the thread that will count it. A pipe
+// is read in order straight into the growing buffer. Either way the input is held only once.
+bool readPlacedInput(LargeBuffer &buffer, size_t threadCount) {
+    size_t length = 0;
+#ifndef _WIN32
+    int descriptor = fileno(stdin);
+    struct stat status;
+    off_t start = lseek(descriptor, 0, SEEK_CUR);
+    if (fstat(descriptor, &status) == 0 && S_ISREG(status.st_mode) && start >= 0 && status.st_size > start) {
+        buffer.allocate((size_t)(status.st_size - start));
+        char *target = buffer.data();
+        vector<size_t> sliceLength(threadCount, 0);
+        runPerChunk(threadCount, [&](size_t i) {
+            size_t begin = buffer.size() * i / threadCount;
+            size_t end = buffer.size() * (i + 1) / threadCount;
+            while (begin + sliceLength[i] < end) {
+                ssize_t got = pread(descriptor, target + begin + sliceLength[i], end - begin - sliceLength[i],
+                                    start + (off_t)(begin + sliceLength[i]));
+                if (got <= 0) {
+                    break; // Error, or the file was truncated while it was read
+                }
+                sliceLength[i] += (size_t)got;
+            }
+        });
+        for (size_t i = 0; i < threadCount; ++i) {
+            if (sliceLength[i] != buffer.size() * (i + 1) / threadCount - buffer.size() * i / threadCount) {
+                return false;
+            }
+        }
+        length = buffer.size();
+        if (lseek(descriptor, start + (off_t)length, SEEK_SET) < 0) {
+            return false;
+        }
+    }
+#endif
+    // The rest (all of a pipe, or what was appended to the file since it was sized) is read in
+    // order; the buffer grows only when more bytes arrive
+    vector<char> chunk(1 << 16);
+    size_t got;
+    while ((got = fread(chunk.data(), 1, chunk.size(), stdin)) > 0) {
+        buffer.resize(length + got);
+        memcpy(buffer.data() + length, chunk.data(), got);
+        length += got;
+    }
+    return !ferror(stdin);
+}
+
+int main(int argc, char *argv[]) {
+    // Parse command-line options
+    bool streamMode = false;
+    bool onlineMode = false;
+    size_t threadCount = 1;
+    OutputOptions outputOptions;
+    string inputPath; // Empty means read from standard input
+    string dictionaryInPath, dictionaryOutPath;
+    string batchListPath; // --batch: file listing the inputs to encode
+    string countsOutPath; // --counts-out: count only and save the partial frequency table
+    StatsReport statsReport("project5"); // --stats: writes the JSON report when main returns
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--stream") == 0) {
+            streamMode = true;
+        } else if (strcmp(argv[i], "--online") == 0) {
+            onlineMode = true;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threadCount = strtoul(argv[++i], nullptr, 10);
+            if (threadCount == 0) {
+                threadCount = max(1u, thread::hardware_concurrency()); // 0 means one per core
+            }
+        } else if (strcmp(argv[i], "--raw-ids") == 0) {
+            outputOptions.format = OutputFormat::RawIds;
+        } else if (strcmp(argv[i], "--binary") == 0) {
+            outputOptions.format = OutputFormat::Binary;
+        } else if (strcmp(argv[i], "--framed") == 0) {
+            outputOptions.format = OutputFormat::Binary;
+            outputOptions.framed = true;
+        } else if (strcmp(argv[i], "--store-counts") == 0) {
+            outputOptions.format = OutputFormat::Binary;
+            outputOptions.storeCounts = true;
+        } else if (strcmp(argv[i], "--huffman") == 0) {
+            outputOptions.format = OutputFormat::Binary;
+            outputOptions.huffman = true;
+        } else if (strcmp(argv[i], "--frame-size") == 0 && i + 1 < argc) {
+            outputOptions.frameSize = strtoull(argv[++i], nullptr, 10);
+            if (outputOptions.frameSize == 0) {
+                cerr << "Error: --frame-size must be at least 1." << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--top-k") == 0 && i + 1 < argc) {
+            outputOptions.topK = strtoull(argv[++i], nullptr, 10);
+            if (outputOptions.topK == 0) {
+                cerr << "Error: --top-k must be at least 1." << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--dict-in") == 0 && i + 1 < argc) {
+            dictionaryInPath = argv[++i];
+        } else if (strcmp(argv[i], "--dict-out") == 0 && i + 1 < argc) {
+            dictionaryOutPath = argv[++i];
+        } else if (strcmp(argv[i], "--counts-out") == 0 && i + 1 < argc) {
+            countsOutPath = argv[++i];
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batchListPath = argv[++i];
+        } else if (strcmp(argv[i], "--lossless") == 0) {
+            outputOptions.format = OutputFormat::Binary;
+            outputOptions.lossless = true;
+        } else if (strcmp(argv[i], "--delimiters") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, "whitespace") == 0) {
+                outputOptions.delimiters = TokenDelimiters::Whitespace;
+            } else if (strcmp(name, "csv") == 0) {
+                outputOptions.delimiters = TokenDelimiters::Csv;
+            } else if (strcmp(name, "pipe") == 0) {
+                outputOptions.delimiters = TokenDelimiters::Pipe;
+            } else {
+                cerr << "Error: --delimiters must be whitespace, csv or pipe." << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--huge-pages") == 0 && i + 1 < argc) {
+            const char *mode = argv[++i];
+            if (strcmp(mode, "off") == 0) {
+                memoryPolicy().hugePages = HugePageMode::Off;
+            } else if (strcmp(mode, "transparent") == 0) {
+                memoryPolicy().hugePages = HugePageMode::Transparent;
+            } else if (strcmp(mode, "explicit") == 0) {
+                memoryPolicy().hugePages = HugePageMode::Explicit;
+            } else {
+                cerr << "Error: --huge-pages must be off, transparent or explicit." << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--numa-local") == 0) {
+            memoryPolicy().numaLocal = true;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            runStats().enabled = true;
+        } else if (argv[i][0] != '-' && inputPath.empty()) {
+            inputPath = argv[i];
+        } else {
+            cerr << "Error: Unknown option '" << argv[i] << "'." << endl;
+            cerr << "Usage: " << argv[0] << " [--stream | --online] [--threads N] [--raw-ids | --binary | --lossless]"
+                 << " [--framed [--frame-size N]] [--huffman | --top-k K] [--store-counts]"
+                 << " [--dict-out FILE | --dict-in FILE]"
+                 << " [--delimiters whitespace|csv|pipe] [--counts-out FILE] [--huge-pages off|transparent|explicit]"
+                 << " [--numa-local] [--batch LIST | input.txt] [--stats]"
+                 << " < input.txt" << endl;
+            return 1;
+        }
+    }
+
+    if (outputOptions.topK > 0 && (outputOptions.huffman || !dictionaryInPath.empty())) {
+        cerr << "Error: --top-k cannot be combined with --huffman or --dict-in." << endl;
+        return 1;
+    }
+
+    if (!countsOutPath.empty()) {
+        if (onlineMode || outputOptions.lossless || outputOptions.topK > 0 || !batchListPath.empty() ||
+            !dictionaryInPath.empty() || !dictionaryOutPath.empty()) {
+            cerr << "Error: --counts-out only counts the input and cannot be combined with --online, --lossless,"
+                 << " --top-k, --batch, --dict-in or --dict-out." << endl;
+            return 1;
+        }
+        return countToPartialTable(inputPath, outputOptions, threadCount, countsOutPath);
+    }
+
+    if (outputOptions.delimiters != TokenDelimiters::Whitespace && outputOptions.format != OutputFormat::Binary) {
+        cerr << "Error: --delimiters other than whitespace need a binary container (--binary, --framed,"
+             << " --huffman or --lossless); the text formats separate dictionary tokens with spaces." << endl;
+        return 1;
+    }
+
+    if (outputOptions.lossless && (outputOptions.format != OutputFormat::Binary || outputOptions.framed || streamMode ||
+                                   onlineMode || !dictionaryInPath.empty())) {
+        cerr << "Error: --lossless writes an unframed binary container and cannot be combined with --raw-ids,"
+             << " --framed, --stream, --online or --dict-in." << endl;
+        return 1;
+    }
+
+    if (outputOptions.storeCounts && (onlineMode || !dictionaryInPath.empty())) {
+        cerr << "Error: --store-counts needs the container's own dictionary and cannot be combined with"
+             << " --online or --dict-in." << endl;
+        return 1;
+    }
+
+    if (onlineMode) {
+        if (outputOptions.format != OutputFormat::Text || !inputPath.empty() || !batchListPath.empty() ||
+            !dictionaryInPath.empty() || !dictionaryOutPath.empty()) {
+            cerr << "Error: --online reads standard input and writes the text format only." << endl;
+            return 1;
+        }
+        return encodeOnline(outputOptions);
+    }
+
+    DictionaryFile dictionary; // Saved ranking for --dict-in
+    TokenTable ranks;          // Token -> rank index of the saved dictionary
+    if (!dictionaryInPath.empty()) {
+        if (outputOptions.huffman || !dictionaryOutPath.empty()) {
+            cerr << "Error: --dict-in cannot be combined with --huffman or --dict-out." << endl;
+            return 1;
+        }
+        string errorMessage;
+        if (!dictionary.open(dictionaryInPath, errorMessage)) {
+            cerr << "Error: " << errorMessage << endl;
+            return 1;
+        }
+        indexDictionary(dictionary, ranks);
+    }
+
+    if (!batchListPath.empty()) {
+        if (!dictionaryOutPath.empty() || streamMode || !inputPath.empty()) {
+            cerr << "Error: --batch cannot be combined with --dict-out, --stream or an input path." << endl;
+            return 1;
+        }
+        return encodeBatch(batchListPath, outputOptions, threadCount, dictionaryInPath.empty() ? nullptr : &dictionary,
+                           ranks);
+    }
+
+    EncoderWorkspace workspace;
+    if (streamMode && inputPath.empty()) {
+        if (!dictionaryInPath.empty()) {
+            return encodeWithDictionary(outputOptions, dictionary, ranks, workspace.literals, string_view(), true);
+        }
+        return encodeStreaming(outputOptions, dictionaryOutPath, true);
+    }
+    if (inputPath.empty() && threadCount == 1 && !outputOptions.lossless && dictionaryInPath.empty()) {
+        // Standard input is tokenized chunk by chunk as it arrives, keeping the ids in memory
+        return encodeStreaming(outputOptions, dictionaryOutPath, false);
+    }
+
+    // Step 1: Get the whole input as one contiguous buffer
+    // A named file is memory-mapped; otherwise standard input is read into a single string
+    // (for --threads, --lossless and --dict-in, which work on the whole buffer)
+    MappedFile mappedInput;
+    string inputContent;
+    LargeBuffer placedContent; // --huge-pages and --numa-local: the input in placed memory
+    string_view input;
+    {
+        STATS_TIMER("read");
+        if (!inputPath.empty()) {
+            string errorMessage;
+            if (!mappedInput.open(inputPath, errorMessage)) {
+                cerr << "Error: " << errorMessage << endl;
+                return 1;
+            }
+            input = mappedInput.view();
+        } else {
+#ifdef _WIN32
+            if (outputOptions.lossless) {
+                _setmode(_fileno(stdin), _O_BINARY); // Keep CR bytes, they are part of the separators
+            }
+#endif
+            bool read = memoryPolicy().active() ? readPlacedInput(placedContent, threadCount)
+                                                : readWholeFile(stdin, inputContent);
+            if (!read) {
+                cerr << "Error: Failed to read standard input." << endl;
+                return 1;
+            }
+            input = memoryPolicy().active() ? placedContent.view() : string_view(inputContent);
+        }
+    }
+    STATS_ADD("bytes_read", input.size());
+    if (!dictionaryInPath.empty()) {
+        return encodeWithDictionary(outputOptions, dictionary, ranks, workspace.literals, input, false);
+    }
+    return encodeBuffer(input, outputOptions, threadCount, workspace, dictionaryOutPath);
+}
+
 /*
  * CODE DOCUMENTATION
  * Project: Text Frequency and Encoding
@@ -142,9 +886,70 @@ int main() {
  * - **Encoding**: Replaces each token in the original text with its position in the sorted list.
  *
  * Implementation Highlights:
- * - Utilizes `unordered_map` for efficient frequency calculation.
- * - Leverages `vector` and `map` for sorting and positional encoding.
+ * - Interns each token once into a dense provisional id (token_table.h) and records the id sequence.
+ * - Sorts the provisional ids and encodes through a flat id-to-position remap array. The sort
+ *   buckets ids by frequency in a counting pass and orders each bucket on cached 8-byte
+ *   prefixes, so few full string compares run; with `--threads` the buckets sort in parallel.
+ * - Finds token boundaries 64 bytes at a time with a runtime-selected SIMD whitespace scanner
+ *   (AVX2/SSE2/NEON, scalar fallback) that matches `isspace` in the C locale.
+ * - The tokenizer is a template on a delimiter policy with a constexpr 256-entry table and an
+ *   unrolled mask kernel per delimiter set (token_scanner.h). `--delimiters csv|pipe` selects the
+ *   policy once per buffer or chunk, so each set runs its own specialized loop.
  * - Handles input dynamically via `std::cin` for compatibility with redirected input.
+ * - `--threads N` counts whitespace-aligned chunks into thread-local tables and merges them
+ *   (parallel_count.h); the ranking is a total order, so the output matches the serial count.
+ *   The encode pass reuses the same chunks, each thread remapping its chunk's ids in place.
+ * - Token ids are stored at the narrowest width the vocabulary allows (narrow_ids.h): 1 byte
+ *   per token up to 256 distinct tokens, 2 bytes up to 65536, else 4. The array widens on demand
+ *   while counting and is remapped to positions in place, so no second id array is allocated.
+ * - Output goes through a 1 MiB buffer with a fast itoa (output_writer.h) and is flushed with
+ *   `fwrite` in large blocks; `--raw-ids` writes the positions as binary 32-bit integers.
+ * - `--binary` writes a compact container (encoded_format.h): a header, a length-prefixed
+ *   dictionary block and the positions as LEB128 varints. `--framed` splits the positions into
+ *   independently decodable frames with an index footer for seeking and parallel decoding.
+ * - `--huffman` entropy-codes the positions with a canonical Huffman code built from the token
+ *   frequencies (entropy_coder.h); only the code length histogram is stored.
+ * - A file path argument memory-maps the file (mapped_file.h); tokens are `string_view`s into
+ *   the mapping (token_scanner.h), so counting allocates no token strings.
+ * - `--stream` reads input in 1 MiB chunks and spills provisional token ids to a temporary file,
+ *   so peak memory is bounded by the vocabulary rather than the input size.
+ * - Reading, tokenizing and writing overlap (async_pipeline.h): a reader thread keeps a ring of
+ *   chunk buffers filled ahead of the tokenizer, and a writer thread writes full output buffers
+ *   while the next one is formatted. Bounded queues between the stages give backpressure, so
+ *   neither side runs more than a few buffers ahead. Standard input is tokenized chunk by chunk
+ *   in this pipeline unless the whole buffer is needed (`--threads`, `--lossless`, `--dict-in`).
+ * - `--dict-out` saves the sorted dictionary as a memory-mappable file (dictionary_file.h).
+ *   `--dict-in` encodes against it in one pass with no counting or sorting; tokens missing from
+ *   the dictionary are written as an escape (position 0) followed by the token itself. Every
+ *   format records the dictionary's token count and fingerprint (the text formats on the
+ *   separator line), so decoding with a different dictionary fails instead of mistranslating.
+ * - `--top-k K` finds the K most frequent tokens with `nth_element` and sorts only those, so a
+ *   huge vocabulary of one-off tokens is not fully sorted; the long tail is escape-encoded.
+ * - `--online` emits positions as input arrives instead of at end of input. The ranking is
+ *   rebuilt periodically from the counts so far (online_model.h), rebuilds are marked in-band
+ *   with "-", and tokens not yet ranked are escaped; the decoder mirrors the same rebuilds.
+ * - `--batch` encodes a list of files in one process on a work-stealing pool (work_pool.h).
+ *   Each worker clears and reuses one set of tables, arenas and buffers for all its files, and a
+ *   `--dict-in` dictionary is mapped and indexed once and shared read-only by every worker.
+ * - `--lossless` records the whitespace run in front of every token (and after the last one) in
+ *   the same tokenizer pass, as the gap between neighbouring token views; one-byte runs skip the
+ *   hash (a single space is only counted, any other byte indexes a 256-entry id table). The
+ *   runs are ranked like tokens and run-length coded into a separator block of the container
+ *   (separator_stream.h), which is usually a tiny fraction of the positions.
+ * - `--counts-out` counts a shard and saves its frequencies as a sorted, front-coded partial
+ *   table (partial_counts.h). `project5_merge` k-way merges the tables of many machines into one
+ *   global dictionary that each machine then encodes its shard against with `--dict-in`.
+ * - `--store-counts` appends the Step 2 counts to the container as a fixed-width table in
+ *   dictionary order, so `project5_query` reads the count of any token without decoding.
+ * - `--huge-pages` and `--numa-local` select a memory placement policy at run time
+ *   (memory_placement.h). Large blocks of the token tables, id arrays and buffered input are
+ *   then mapped on their own, with transparent or hugetlbfs huge pages, and in parallel mode
+ *   every chunk thread is bound to a node so the memory it first touches stays local. Where
+ *   huge pages or NUMA are not available the flags fall back to ordinary allocation.
+ * - `--stats` reports the wall time of each step, the bytes and tokens read, the hash table's
+ *   load factor and average probe length, the arena bytes and the peak RSS as one JSON object on
+ *   stderr (stage_stats.h). The hooks read no clock unless `--stats` is given, and
+ *   `-DP5_NO_STATS` removes them from the build.
  *
  * LLM and GitHub Copilot Usage Documentation:
  *
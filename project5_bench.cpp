@@ -0,0 +1,934 @@
+/*
+ * Program Name: Text Encoding Benchmark
+ *
+ * Description:
+ * This program measures the encoder pipeline stage by stage on a synthetic or given corpus.
+ * Synthetic corpora draw tokens from a Zipf distribution over a fixed vocabulary, which is
+ * close to how word and log token frequencies fall off in practice.
+ *
+ * Each run times the stages separately: read (loading the input into memory), count, sort,
+ * rank-map, encode, write (the text output, into a temporary file) and decode. It reports
+ * seconds, MB/s and tokens/s per stage and the peak resident memory of the process. The decoded
+ * text is compared with the input tokens, so every benchmark run is also a correctness check.
+ *
+ * `--baseline` runs the same stages with the original implementation (unordered_map counting
+ * over an istringstream, a vector<pair<string, int>> sort, a map<string, int> lookup and
+ * iostream output) so changes can be compared with where the project started.
+ *
+ * `--check` is a differential test: it runs inputs through the original implementation and
+ * through the stages `project5` runs on a buffer (EncoderWorkspace, rankTokens and EncodedOutput
+ * from text_codec.h, serial and on parallel chunks, in every output format, with top-K and
+ * lossless), the streaming tokenizer and the library Encoder and Decoder, and reports every
+ * dictionary, output byte, position or round trip that differs. The inputs are fixed
+ * adversarial cases (empty, all whitespace, one huge token, 100K unique tokens, id width
+ * boundaries, ties) and random ones drawn from --seed; the default run takes seconds, and
+ * `--unique 10000000` turns the unique-token case into a large-vocabulary stress test that
+ * takes minutes. `--record` and `--compare` turn the benchmark into a regression gate.
+ *
+ * Usage:
+ *   project5_bench                              Benchmark a 10M-token Zipf corpus (100K vocabulary)
+ *   project5_bench --tokens N --vocab V --zipf S --seed X
+ *                                               Benchmark a corpus with these parameters
+ *   project5_bench input.txt                    Benchmark a given file instead
+ *   project5_bench --threads N                  Count, sort and encode on N threads
+ *   project5_bench --repeat R                   Report the fastest of R runs per stage
+ *   project5_bench --baseline                   Also time the original implementation
+ *   project5_bench --generate --tokens N > corpus.txt
+ *                                               Only write the synthetic corpus to standard output
+ *   project5_bench --check [--cases N] [--unique N]
+ *                                               Compare every optimized path with the original
+ *                                               implementation on adversarial and N random inputs
+ *                                               (300 by default; N unique tokens, default 100K)
+ *   project5_bench --record FILE                Save the MB/s of every stage to FILE
+ *   project5_bench --compare FILE [--max-slowdown P]
+ *                                               Fail if a stage is more than P% (default 10) slower
+ *                                               than in FILE
+ *
+ * Build: g++ -std=c++17 -O2 -pthread project5_bench.cpp -o project5_bench
+ *        (add -lpsapi when building with MinGW on Windows)
+ */
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+#include "mapped_file.h"
+#include "output_writer.h"
+#include "parallel_count.h"
+#include "stage_stats.h"
+#include "text_codec.h"
+#include "token_scanner.h"
+#include "token_table.h"
+
+using namespace std;
+
+// Parameters of a synthetic corpus
+struct CorpusOptions {
+    uint64_t tokenCount = 10000000;
+    size_t vocabularySize = 100000;
+    double zipfExponent = 1.0;
+    uint64_t seed = 1;
+};
+
+// Helper function to make the token of a vocabulary rank
+// Letters drawn from the rank give tokens of different lengths; the base-36 rank suffix keeps
+// every token distinct
+string vocabularyToken(size_t rank) {
+    uint64_t state = rank * 0x9E3779B97F4A7C15ull + 1;
+    string token;
+    size_t letterCount = 1 + (size_t)(state >> 61); // 1 to 8 letters
+    for (size_t i = 0; i < letterCount; ++i) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        token += (char)('a' + (state >> 33) % 26);
+    }
+    do {
+        token += "0123456789abcdefghijklmnopqrstuvwxyz"[rank % 36];
+        rank /= 36;
+    } while (rank > 0);
+    return token;
+}
+
+// Helper function to generate a Zipf-distributed corpus
+// Rank r is drawn with probability proportional to 1 / r^s; tokens are separated by spaces
+// with a line break roughly every 12 tokens
+string generateCorpus(const CorpusOptions &options) {
+    vector<string> vocabulary(options.vocabularySize);
+    vector<double> cumulative(options.vocabularySize);
+    double total = 0.0;
+    for (size_t rank = 0; rank < options.vocabularySize; ++rank) {
+        vocabulary[rank] = vocabularyToken(rank);
+        total += 1.0 / pow((double)(rank + 1), options.zipfExponent);
+        cumulative[rank] = total;
+    }
+    mt19937_64 random(options.seed);
+    uniform_real_distribution<double> uniform(0.0, total);
+    string corpus;
+    corpus.reserve((size_t)options.tokenCount * 8);
+    for (uint64_t i = 0; i < options.tokenCount; ++i) {
+        size_t rank = (size_t)(upper_bound(cumulative.begin(), cumulative.end(), uniform(random)) - cumulative.begin());
+        corpus += vocabulary[min(rank, options.vocabularySize - 1)];
+        corpus += random() % 12 == 0 ? '\n' : ' ';
+    }
+    return corpus;
+}
+
+// Wall-clock time of each stage of one run, in seconds
+struct StageTimes {
+    static constexpr int STAGE_COUNT = 7;
+    double seconds[STAGE_COUNT] = {};
+    bool verified = false;
+    int runCount = 0;
+
+    // Keeps the fastest time of each stage; verified only if every run was
+    void keepFastest(const StageTimes &run) {
+        for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+            seconds[stage] = runCount == 0 ? run.seconds[stage] : min(seconds[stage], run.seconds[stage]);
+        }
+        verified = (runCount == 0 || verified) && run.verified;
+        ++runCount;
+    }
+};
+
+const char *const STAGE_NAMES[StageTimes::STAGE_COUNT] = {"read", "count", "sort", "rank-map",
+                                                          "encode", "write", "decode"};
+
+// Helper function to time one stage
+template <typename StageFunction>
+double timeStage(StageFunction &&stage) {
+    auto start = chrono::steady_clock::now();
+    stage();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Helper function to join the input tokens with single spaces, as the decoder writes them
+string expectedDecodedText(string_view input) {
+    string text;
+    forEachToken(input.data(), input.size(), [&text](string_view token) {
+        if (!text.empty()) {
+            text += ' ';
+        }
+        text.append(token);
+    });
+    return text;
+}
+
+// Helper function to list the tokens of a table in sorted order
+vector<string_view> sortedTokenViews(const TokenTable &table, const vector<int> &sortedIds) {
+    vector<string_view> tokens;
+    tokens.reserve(sortedIds.size());
+    for (int id : sortedIds) {
+        tokens.push_back(table.token(id));
+    }
+    return tokens;
+}
+
+// Helper function to widen a narrow id array back to ints
+void appendPositions(const NarrowIdArray &ids, vector<int> &positions) {
+    size_t first = positions.size();
+    positions.resize(first + ids.size());
+    ids.read(0, ids.size(), positions.data() + first);
+}
+
+// Helper function to gather the positions of a workspace, parallel chunks in input order
+vector<int> workspacePositions(const EncoderWorkspace &workspace) {
+    vector<int> positions;
+    appendPositions(workspace.tokenIds, positions);
+    for (const ChunkCount &chunk : workspace.chunkCounts) {
+        appendPositions(chunk.tokenIds, positions);
+    }
+    return positions;
+}
+
+// Runs the current pipeline once over the input: the stages of project5's buffer encoder
+// `load` produces the input buffer, so the read stage covers either a file or a corpus copy
+template <typename LoadFunction>
+StageTimes runPipeline(LoadFunction &&load, size_t threadCount, const string &expected) {
+    StageTimes times;
+    string input;
+    EncoderWorkspace workspace;
+    vector<int> sortedIds, idPosition;
+    times.seconds[0] = timeStage([&] { input = load(); });
+    times.seconds[1] = timeStage([&] { workspace.count(input, threadCount, TokenDelimiters::Whitespace, false); });
+    times.seconds[2] = timeStage([&] { sortedIds = sortTokenIds(workspace.table, threadCount); });
+    times.seconds[3] = timeStage([&] { idPosition = buildPositionMap(sortedIds); });
+    times.seconds[4] = timeStage([&] { workspace.remap(idPosition); });
+    times.seconds[5] = timeStage([&] {
+        FILE *sink = tmpfile();
+        OutputOptions options;
+        options.destination = sink != nullptr ? sink : stdout;
+        {
+            EncodedOutput output(options);
+            output.writeDictionary(workspace.table, sortedIds, workspace.idCount());
+            workspace.writePositions(output);
+            output.finish();
+        }
+        if (sink != nullptr) {
+            fclose(sink);
+        }
+    });
+    vector<int> encodedText = workspacePositions(workspace); // Widened outside the timed decode
+    string decoded;
+    times.seconds[6] = timeStage([&] {
+        Decoder decoder;
+        decoder.setDictionary(sortedTokenViews(workspace.table, sortedIds));
+        string errorMessage;
+        decoder.decode(encodedText.data(), encodedText.size(), decoded, errorMessage);
+    });
+    times.verified = decoded == expected;
+    return times;
+}
+
+// Dictionary and positions produced by one encoder path
+struct EncodingResult {
+    vector<string> dictionary; // Tokens in sorted order
+    vector<int> positions;     // 1-based position of every input token
+};
+
+// Runs the original implementation once over the input
+// `result` (if not null) receives the dictionary and positions, the reference for --check
+template <typename LoadFunction>
+StageTimes runBaseline(LoadFunction &&load, const string &expected, EncodingResult *result = nullptr) {
+    StageTimes times;
+    string inputContent;
+    unordered_map<string, int> tokenFrequency;
+    vector<pair<string, int>> sortedTokens;
+    map<string, int> tokenPosition;
+    vector<int> encodedText;
+    times.seconds[0] = timeStage([&] { inputContent = load(); });
+    times.seconds[1] = timeStage([&] {
+        string token;
+        char aChar;
+        istringstream inputStream(inputContent);
+        while (inputStream.get(aChar)) {
+            if (isspace((unsigned char)aChar)) {
+                if (!token.empty()) {
+                    tokenFrequency[token]++;
+                }
+                token.clear();
+            } else {
+                token += aChar;
+            }
+        }
+        if (!token.empty()) {
+            tokenFrequency[token]++;
+        }
+    });
+    times.seconds[2] = timeStage([&] {
+        sortedTokens.assign(tokenFrequency.begin(), tokenFrequency.end());
+        sort(sortedTokens.begin(), sortedTokens.end(), [](const pair<string, int> &a, const pair<string, int> &b) {
+            if (a.second != b.second) {
+                return a.second > b.second;
+            }
+            return a.first < b.first;
+        });
+    });
+    times.seconds[3] = timeStage([&] {
+        int position = 1;
+        for (const auto &entry : sortedTokens) {
+            tokenPosition[entry.first] = position++;
+        }
+    });
+    times.seconds[4] = timeStage([&] {
+        string token;
+        char aChar;
+        istringstream secondPass(inputContent);
+        while (secondPass.get(aChar)) {
+            if (isspace((unsigned char)aChar)) {
+                if (!token.empty()) {
+                    encodedText.push_back(tokenPosition.find(token)->second);
+                }
+                token.clear();
+            } else {
+                token += aChar;
+            }
+        }
+        if (!token.empty()) {
+            encodedText.push_back(tokenPosition.find(token)->second);
+        }
+    });
+    times.seconds[5] = timeStage([&] {
+        ostringstream output;
+        for (const auto &entry : sortedTokens) {
+            output << entry.first << " ";
+        }
+        output << endl << "**********" << endl;
+        for (int position : encodedText) {
+            output << position << " ";
+        }
+        output << endl;
+        FILE *sink = tmpfile();
+        if (sink != nullptr) {
+            string text = output.str();
+            fwrite(text.data(), 1, text.size(), sink);
+            fclose(sink);
+        }
+    });
+    string decoded;
+    times.seconds[6] = timeStage([&] {
+        stringstream decodedText;
+        for (size_t i = 0; i < encodedText.size(); ++i) {
+            if (i > 0) {
+                decodedText << " ";
+            }
+            decodedText << sortedTokens[encodedText[i] - 1].first;
+        }
+        decoded = decodedText.str();
+    });
+    times.verified = decoded == expected;
+    if (result != nullptr) {
+        result->dictionary.clear();
+        for (const auto &entry : sortedTokens) {
+            result->dictionary.push_back(entry.first);
+        }
+        result->positions = encodedText;
+    }
+    return times;
+}
+
+// Helper function to print one result table
+void printTimes(const char *title, const StageTimes &times, uint64_t inputBytes, uint64_t tokenCount) {
+    printf("%s%s\n", title, times.verified ? "" : "  (DECODED TEXT DOES NOT MATCH THE INPUT)");
+    printf("  %-9s %10s %10s %14s\n", "stage", "seconds", "MB/s", "tokens/s");
+    double total = 0.0;
+    for (int stage = 0; stage < StageTimes::STAGE_COUNT; ++stage) {
+        double seconds = max(times.seconds[stage], 1e-9);
+        total += times.seconds[stage];
+        printf("  %-9s %10.4f %10.1f %14.0f\n", STAGE_NAMES[stage], times.seconds[stage], inputBytes / 1e6 / seconds,
+               tokenCount / seconds);
+    }
+    printf("  %-9s %10.4f %10.1f %14.0f\n", "total", total, inputBytes / 1e6 / max(total, 1e-9),
+           tokenCount / max(total, 1e-9));
+}
+
+// Helper function to describe how a path's dictionary and positions differ from the reference
+// Returns an empty string if they are identical
+template <typename TokenList, typename PositionList>
+string describeMismatch(const EncodingResult &reference, const TokenList &dictionary, const PositionList &positions) {
+    if (dictionary.size() != reference.dictionary.size()) {
+        return "dictionary has " + to_string(dictionary.size()) + " tokens, expected " +
+               to_string(reference.dictionary.size());
+    }
+    for (size_t i = 0; i < dictionary.size(); ++i) {
+        if (string_view(dictionary[i]) != reference.dictionary[i]) {
+            return "dictionary differs at position " + to_string(i + 1);
+        }
+    }
+    if (positions.size() != reference.positions.size()) {
+        return "has " + to_string(positions.size()) + " positions, expected " + to_string(reference.positions.size());
+    }
+    for (size_t i = 0; i < positions.size(); ++i) {
+        if (positions[i] != reference.positions[i]) {
+            return "position of token " + to_string(i) + " is " + to_string(positions[i]) + ", expected " +
+                   to_string(reference.positions[i]);
+        }
+    }
+    return "";
+}
+
+// Helper function to capture what a writer puts into a file (a temporary file)
+template <typename WriteFunction>
+string writeToString(WriteFunction &&write) {
+    string bytes;
+    FILE *file = tmpfile();
+    if (file == nullptr) {
+        return bytes;
+    }
+    write(file);
+    long size = ftell(file);
+    rewind(file);
+    bytes.resize(size > 0 ? (size_t)size : 0);
+    bytes.resize(fread(&bytes[0], 1, bytes.size(), file));
+    fclose(file);
+    return bytes;
+}
+
+// Helper function to run the counting and ranking stages of project5's buffer encoder
+// (encodeBuffer) over the input; leaves the ranking in `sortedIds` and the positions in `workspace`
+void encodeLikeProject5(const string &input, size_t threadCount, const OutputOptions &options,
+                        EncoderWorkspace &workspace, vector<int> &sortedIds) {
+    if (options.lossless) {
+        threadCount = 1;
+    }
+    workspace.clear();
+    workspace.count(input, threadCount, options.delimiters, options.lossless);
+    vector<int> idPosition;
+    sortedIds = rankTokens(workspace.table, options.topK, threadCount, idPosition);
+    workspace.remap(idPosition);
+}
+
+// Helper function to run the output stage of project5's buffer encoder; returns the output bytes
+string writeLikeProject5(OutputOptions options, const EncoderWorkspace &workspace, const vector<int> &sortedIds) {
+    return writeToString([&](FILE *file) {
+        options.destination = file;
+        EncodedOutput output(options);
+        output.setLiterals(workspace.table);
+        if (options.lossless) {
+            output.setSeparators(workspace.separators);
+        }
+        output.writeDictionary(workspace.table, sortedIds, workspace.idCount());
+        workspace.writePositions(output);
+        output.finish();
+    });
+}
+
+// Helper function to write the reference result in a text format, as the original program does
+string referenceOutput(const EncodingResult &reference, OutputFormat format) {
+    string bytes;
+    for (const string &token : reference.dictionary) {
+        bytes += token;
+        bytes += ' ';
+    }
+    bytes += "\n**********\n";
+    for (int position : reference.positions) {
+        if (format == OutputFormat::Text) {
+            bytes += to_string(position);
+            bytes += ' ';
+            continue;
+        }
+        for (int shift = 0; shift < 32; shift += 8) { // 4-byte little-endian
+            bytes += (char)(((uint32_t)position >> shift) & 0xFF);
+        }
+    }
+    if (format == OutputFormat::Text) {
+        bytes += '\n';
+    }
+    return bytes;
+}
+
+// Runs one input through every optimized path and compares each with the original implementation
+// Prints a line per mismatch and returns the number of mismatches
+int checkInput(const string &caseName, const string &input, mt19937_64 &random) {
+    int failureCount = 0;
+    auto check = [&](const string &path, const string &mismatch) {
+        if (!mismatch.empty()) {
+            printf("  FAIL %s, %s: %s\n", caseName.c_str(), path.c_str(), mismatch.c_str());
+            ++failureCount;
+        }
+    };
+    auto checkContainer = [&](const string &path, const string &container, const string &want) {
+        Decoder decoder;
+        string decoded, errorMessage;
+        bool decodedWell = decoder.decodeContainer(container, decoded, errorMessage);
+        check(path, decodedWell && decoded == want ? "" : "decoded text differs " + errorMessage);
+    };
+    string expected = expectedDecodedText(input);
+    EncodingResult reference;
+    if (!runBaseline([&input] { return input; }, expected, &reference).verified) {
+        check("original", "the original implementation does not round-trip");
+    }
+    string expectedText = referenceOutput(reference, OutputFormat::Text);
+    string expectedRawIds = referenceOutput(reference, OutputFormat::RawIds);
+
+    // project5's buffer encoder on one thread and on parallel chunks, in every output format
+    EncoderWorkspace workspace;
+    vector<int> sortedIds;
+    for (size_t threadCount : {(size_t)1, (size_t)2, (size_t)3, (size_t)8}) {
+        string threads = ", " + to_string(threadCount) + " threads";
+        OutputOptions options;
+        encodeLikeProject5(input, threadCount, options, workspace, sortedIds);
+        check("encode" + threads,
+              describeMismatch(reference, sortedTokenViews(workspace.table, sortedIds), workspacePositions(workspace)));
+        string text = writeLikeProject5(options, workspace, sortedIds);
+        check("text output" + threads, text == expectedText ? "" : "differs from the original output");
+        options.format = OutputFormat::RawIds;
+        string rawIds = writeLikeProject5(options, workspace, sortedIds);
+        check("raw ids" + threads, rawIds == expectedRawIds ? "" : "differs from the original positions");
+        if (threadCount != 1 && threadCount != 3) {
+            continue; // The containers are checked once serially and once on parallel chunks
+        }
+
+        options.format = OutputFormat::Binary;
+        options.storeCounts = threadCount == 1; // Each container variant once serially or in parallel
+        checkContainer("container" + threads, writeLikeProject5(options, workspace, sortedIds), expected);
+        options.storeCounts = false;
+        options.huffman = true;
+        options.framed = threadCount == 3;
+        options.frameSize = 1 + random() % 1000;
+        checkContainer("huffman container" + threads, writeLikeProject5(options, workspace, sortedIds), expected);
+        options.huffman = false;
+        options.framed = true;
+        checkContainer("framed container" + threads, writeLikeProject5(options, workspace, sortedIds), expected);
+    }
+
+    // Top-K ranking: the first K tokens of the full ranking, the rest written as escapes
+    // The small K counts serially and the large one on parallel chunks
+    for (size_t k : {(size_t)1, reference.dictionary.size() / 2 + 1}) {
+        size_t threadCount = k == 1 ? 1 : 3;
+        string path = "top-" + to_string(k) + ", " + to_string(threadCount) + " threads";
+        OutputOptions options;
+        options.format = OutputFormat::Binary;
+        options.topK = k;
+        encodeLikeProject5(input, threadCount, options, workspace, sortedIds);
+        vector<string_view> topTokens = sortedTokenViews(workspace.table, sortedIds);
+        size_t expectedSize = min(k, reference.dictionary.size());
+        bool same = topTokens.size() == expectedSize &&
+                    equal(topTokens.begin(), topTokens.end(), reference.dictionary.begin());
+        check(path, same ? "" : "differs from the first K tokens of the full ranking");
+        checkContainer(path + " container", writeLikeProject5(options, workspace, sortedIds), expected);
+    }
+
+    // Lossless mode: the separators come back byte for byte
+    {
+        OutputOptions options;
+        options.format = OutputFormat::Binary;
+        options.lossless = true;
+        encodeLikeProject5(input, 4, options, workspace, sortedIds);
+        check("lossless",
+              describeMismatch(reference, sortedTokenViews(workspace.table, sortedIds), workspacePositions(workspace)));
+        checkContainer("lossless container", writeLikeProject5(options, workspace, sortedIds), input);
+        options.huffman = true;
+        checkContainer("lossless huffman container", writeLikeProject5(options, workspace, sortedIds), input);
+        options.huffman = false;
+        options.topK = reference.dictionary.size() / 2 + 1;
+        encodeLikeProject5(input, 4, options, workspace, sortedIds);
+        checkContainer("lossless top-K container", writeLikeProject5(options, workspace, sortedIds), input);
+    }
+
+    // Streaming tokenizer fed in random chunk sizes, copying tokens into the table's arena
+    {
+        TokenTable table;
+        NarrowIdArray ids;
+        StreamTokenizer tokenizer;
+        auto onToken = [&](string_view token) { ids.push(table.internCopy(token)); };
+        for (size_t offset = 0; offset < input.size();) {
+            size_t length = min<size_t>(input.size() - offset, 1 + random() % (random() % 2 == 0 ? 17 : 70000));
+            tokenizer.feed(input.data() + offset, length, onToken);
+            offset += length;
+        }
+        tokenizer.finish(onToken);
+        vector<int> sortedIds = sortTokenIds(table);
+        ids.remap(buildPositionMap(sortedIds));
+        vector<int> positions;
+        appendPositions(ids, positions);
+        check("stream", describeMismatch(reference, sortedTokenViews(table, sortedIds), positions));
+    }
+
+    // Library encoder and decoder (text_codec.h), which embed the same stages
+    {
+        Encoder encoder;
+        encoder.encode(input);
+        encoder.finish();
+        check("library", describeMismatch(reference, encoder.dictionary(), encoder.positions()));
+        string text = writeToString([&](FILE *file) {
+            OutputOptions options;
+            options.destination = file;
+            encoder.write(options);
+        });
+        check("library output", text == expectedText ? "" : "differs from the original output");
+        Decoder decoder;
+        decoder.setDictionary(encoder.dictionary());
+        string decoded, errorMessage;
+        decoder.decode(encoder.positions().data(), encoder.positions().size(), decoded, errorMessage);
+        check("library decode", decoded == expected ? "" : "decoded text differs " + errorMessage);
+
+        encoder.reset();
+        for (size_t offset = 0; offset < input.size();) {
+            size_t length = min<size_t>(input.size() - offset, 1 + random() % 4096);
+            encoder.feed(string_view(input).substr(offset, length));
+            offset += length;
+        }
+        encoder.finish();
+        check("library feed", describeMismatch(reference, encoder.dictionary(), encoder.positions()));
+
+        encoder.reset();
+        encoder.keepSeparators();
+        encoder.encode(input);
+        encoder.finish();
+        decoded.clear();
+        decoder.setDictionary(encoder.dictionary());
+        decoder.decodeLossless(encoder.positions().data(), encoder.positions().size(), encoder.separators(), decoded,
+                               errorMessage);
+        check("library lossless", decoded == input ? "" : "output differs from the input " + errorMessage);
+    }
+    return failureCount;
+}
+
+// Helper function to build the fixed adversarial inputs of --check
+vector<pair<string, string>> adversarialInputs(size_t uniqueTokenCount, mt19937_64 &random) {
+    const char WHITESPACE[] = " \t\n\v\f\r";
+    vector<pair<string, string>> inputs;
+    inputs.push_back({"empty", ""});
+    string whitespace(200000, ' ');
+    for (char &aChar : whitespace) {
+        aChar = WHITESPACE[random() % 6];
+    }
+    inputs.push_back({"all whitespace", whitespace});
+    string hugeToken(8 << 20, 'x');
+    for (char &aChar : hugeToken) {
+        aChar = (char)('!' + random() % 94);
+    }
+    inputs.push_back({"one huge token", hugeToken});
+    inputs.push_back({"one huge token between whitespace", "\n \t" + hugeToken + " \r\n"});
+    string unique;
+    for (size_t rank = 0; rank < uniqueTokenCount; ++rank) { // Every count is 1, so the order is all ties
+        unique += vocabularyToken(rank);
+        unique += ' ';
+    }
+    inputs.push_back({to_string(uniqueTokenCount) + " unique tokens", unique});
+    string boundaries; // Token and gap lengths cycle so tokens start and end at every block offset
+    for (size_t i = 0; boundaries.size() < (1 << 20); ++i) {
+        boundaries.append(1 + i % 131, (char)('a' + i % 5));
+        boundaries.append(1 + i % 3, WHITESPACE[i % 6]);
+    }
+    inputs.push_back({"scanner block boundaries", boundaries});
+    string allBytes(1 << 20, '\0');
+    for (char &aChar : allBytes) {
+        aChar = (char)(random() & 0xFF);
+    }
+    inputs.push_back({"all byte values", allBytes});
+    for (size_t distinct : {(size_t)256, (size_t)257, (size_t)65536, (size_t)65537}) {
+        string vocabulary; // Crosses the 1-, 2- and 4-byte widths of the narrow id arrays
+        for (size_t rank = 0; rank < distinct; ++rank) {
+            for (size_t copy = 0; copy < 1 + rank % 3; ++copy) {
+                vocabulary += vocabularyToken(rank);
+                vocabulary += '\n';
+            }
+        }
+        inputs.push_back({to_string(distinct) + " distinct tokens", vocabulary});
+    }
+    vector<string> tied;
+    for (size_t rank = 0; rank < 5000; ++rank) {
+        tied.insert(tied.end(), 3, vocabularyToken(rank));
+    }
+    shuffle(tied.begin(), tied.end(), random);
+    string equalCounts;
+    for (const string &token : tied) {
+        equalCounts += token;
+        equalCounts += ' ';
+    }
+    inputs.push_back({"equal counts", equalCounts});
+    return inputs;
+}
+
+// Helper function to make a random input for --check
+// Small alphabets give many repeated tokens and ties, raw bytes give odd tokens and whitespace,
+// and Zipf corpora look like real text
+string randomInput(mt19937_64 &random) {
+    size_t length = random() % 4 == 0 ? random() % 200000 : random() % 3000;
+    string input;
+    switch (random() % 3) {
+    case 0: {
+        size_t alphabet = 1 + random() % 4;
+        size_t gapPercent = 5 + random() % 60;
+        const char WHITESPACE[] = " \t\n\v\f\r";
+        for (size_t i = 0; i < length; ++i) {
+            if (random() % 100 < gapPercent) {
+                input += WHITESPACE[random() % 6];
+            } else {
+                input += (char)('a' + random() % alphabet);
+            }
+        }
+        break;
+    }
+    case 1:
+        input.resize(length);
+        for (char &aChar : input) {
+            aChar = random() % 8 == 0 ? ' ' : (char)(random() & 0xFF);
+        }
+        break;
+    default: {
+        CorpusOptions options;
+        options.tokenCount = length / 4;
+        options.vocabularySize = 1 + random() % 5000;
+        options.zipfExponent = 0.5 + (double)(random() % 100) / 100.0;
+        options.seed = random();
+        input = generateCorpus(options);
+        break;
+    }
+    }
+    return input;
+}
+
+// Differential check of every optimized path against the original implementation
+// Returns the number of mismatches
+int runCheck(uint64_t seed, int caseCount, size_t uniqueTokenCount) {
+    mt19937_64 random(seed);
+    printf("check: adversarial inputs and %d random inputs (seed %llu)\n", caseCount, (unsigned long long)seed);
+    int failureCount = 0;
+    for (const auto &[name, input] : adversarialInputs(uniqueTokenCount, random)) {
+        int failures = checkInput(name, input, random);
+        printf("  %-36s %s\n", name.c_str(), failures == 0 ? "ok" : "FAILED");
+        failureCount += failures;
+    }
+    int failedCases = 0;
+    for (int i = 0; i < caseCount; ++i) {
+        int failures = checkInput("random input " + to_string(i), randomInput(random), random);
+        failedCases += failures > 0;
+        failureCount += failures;
+    }
+    printf("  %-36s %s\n", (to_string(caseCount) + " random inputs").c_str(),
+           failedCases == 0 ? "ok" : (to_string(failedCases) + " FAILED").c_str());
+    printf("check: %s\n\n", failureCount == 0 ? "every path matches the original implementation"
+                                              : (to_string(failureCount) + " mismatches").c_str());
+    return failureCount;
+}
+
+// Helper function to save the stage throughputs of a run for later --compare runs
+bool recordThroughput(const string &path, const StageTimes &times, uint64_t inputBytes, uint64_t tokenCount,
+                      size_t threadCount) {
+    FILE *file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        cerr << "Error: Could not create '" << path << "'." << endl;
+        return false;
+    }
+    fprintf(file, "input_bytes %llu\ntokens %llu\nthreads %zu\n", (unsigned long long)inputBytes,
+            (unsigned long long)tokenCount, threadCount);
+    for (int stage = 0; stage < StageTimes::STAGE_COUNT; ++stage) {
+        fprintf(file, "%s %.6f\n", STAGE_NAMES[stage], inputBytes / 1e6 / max(times.seconds[stage], 1e-9));
+    }
+    if (fclose(file) != 0) {
+        cerr << "Error: Failed to write '" << path << "'." << endl;
+        return false;
+    }
+    return true;
+}
+
+// Compares the stage throughputs of a run with the ones saved by --record
+// Returns 1 if the file does not match the run or a stage is more than maxSlowdown percent slower
+int compareThroughput(const string &path, const StageTimes &times, uint64_t inputBytes, uint64_t tokenCount,
+                      size_t threadCount, double maxSlowdown) {
+    FILE *file = fopen(path.c_str(), "r");
+    if (file == nullptr) {
+        cerr << "Error: Could not open '" << path << "'." << endl;
+        return 1;
+    }
+    unsigned long long recordedBytes = 0, recordedTokens = 0;
+    size_t recordedThreads = 0;
+    bool header = fscanf(file, "input_bytes %llu tokens %llu threads %zu", &recordedBytes, &recordedTokens,
+                         &recordedThreads) == 3;
+    double recorded[StageTimes::STAGE_COUNT];
+    for (int stage = 0; header && stage < StageTimes::STAGE_COUNT; ++stage) {
+        char name[32];
+        header = fscanf(file, "%31s %lf", name, &recorded[stage]) == 2 && strcmp(name, STAGE_NAMES[stage]) == 0;
+    }
+    fclose(file);
+    if (!header) {
+        cerr << "Error: '" << path << "' is not a throughput file written by --record." << endl;
+        return 1;
+    }
+    if (recordedBytes != inputBytes || recordedTokens != tokenCount || recordedThreads != threadCount) {
+        cerr << "Error: '" << path << "' was recorded for another input or thread count." << endl;
+        return 1;
+    }
+    printf("\nthroughput against %s (slowdown limit %.0f%%)\n", path.c_str(), maxSlowdown);
+    int status = 0;
+    for (int stage = 0; stage < StageTimes::STAGE_COUNT; ++stage) {
+        double current = inputBytes / 1e6 / max(times.seconds[stage], 1e-9);
+        double change = recorded[stage] > 0 ? (current / recorded[stage] - 1.0) * 100.0 : 0.0;
+        bool regressed = change < -maxSlowdown;
+        printf("  %-9s %10.1f MB/s, recorded %10.1f MB/s, %+7.1f%%%s\n", STAGE_NAMES[stage], current,
+               recorded[stage], change, regressed ? "  REGRESSION" : "");
+        status |= regressed ? 1 : 0;
+    }
+    return status;
+}
+
+int main(int argc, char *argv[]) {
+    // Parse command-line options
+    CorpusOptions corpusOptions;
+    size_t threadCount = 1;
+    int repeatCount = 1;
+    bool baseline = false;
+    bool generateOnly = false;
+    bool checkPaths = false;
+    int caseCount = 300;
+    size_t uniqueTokenCount = 100000; // Large vocabularies only with an explicit --unique
+    string recordPath;
+    string comparePath;
+    double maxSlowdown = 10.0;
+    string inputPath; // Empty means generate a corpus
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--tokens") == 0 && i + 1 < argc) {
+            corpusOptions.tokenCount = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--vocab") == 0 && i + 1 < argc) {
+            corpusOptions.vocabularySize = max<size_t>(1, strtoull(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--zipf") == 0 && i + 1 < argc) {
+            corpusOptions.zipfExponent = strtod(argv[++i], nullptr);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            corpusOptions.seed = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threadCount = strtoul(argv[++i], nullptr, 10);
+            if (threadCount == 0) {
+                threadCount = max(1u, thread::hardware_concurrency()); // 0 means one per core
+            }
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeatCount = max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--baseline") == 0) {
+            baseline = true;
+        } else if (strcmp(argv[i], "--generate") == 0) {
+            generateOnly = true;
+        } else if (strcmp(argv[i], "--check") == 0) {
+            checkPaths = true;
+        } else if (strcmp(argv[i], "--cases") == 0 && i + 1 < argc) {
+            caseCount = max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--unique") == 0 && i + 1 < argc) {
+            uniqueTokenCount = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) {
+            comparePath = argv[++i];
+        } else if (strcmp(argv[i], "--max-slowdown") == 0 && i + 1 < argc) {
+            maxSlowdown = strtod(argv[++i], nullptr);
+        } else if (argv[i][0] != '-' && inputPath.empty()) {
+            inputPath = argv[i];
+        } else {
+            cerr << "Error: Unknown option '" << argv[i] << "'." << endl;
+            cerr << "Usage: " << argv[0] << " [--tokens N] [--vocab V] [--zipf S] [--seed X] [--threads N]"
+                 << " [--repeat R] [--baseline] [--check [--cases N] [--unique N]]"
+                 << " [--record FILE | --compare FILE [--max-slowdown P]] [--generate | input.txt]" << endl;
+            return 1;
+        }
+    }
+
+    // Step 0: Compare every optimized path with the original implementation
+    if (checkPaths) {
+        int failureCount = runCheck(corpusOptions.seed, caseCount, uniqueTokenCount);
+        if (failureCount > 0 || (recordPath.empty() && comparePath.empty())) {
+            return failureCount > 0 ? 1 : 0;
+        }
+    }
+
+    // Step 1: Get the corpus
+    string corpus;
+    MappedFile mappedInput;
+    if (inputPath.empty()) {
+        corpus = generateCorpus(corpusOptions);
+        if (generateOnly) {
+            OutputWriter writer;
+            writer.write(corpus);
+            return writer.flush() ? 0 : 1;
+        }
+    } else {
+        string errorMessage;
+        if (!mappedInput.open(inputPath, errorMessage)) {
+            cerr << "Error: " << errorMessage << endl;
+            return 1;
+        }
+    }
+    // The read stage copies the corpus or reads the file into a fresh buffer
+    auto load = [&]() -> string {
+        return inputPath.empty() ? corpus : string(mappedInput.view());
+    };
+    string_view input = inputPath.empty() ? string_view(corpus) : mappedInput.view();
+    string expected = expectedDecodedText(input);
+    uint64_t tokenCount = 0;
+    forEachToken(input.data(), input.size(), [&tokenCount](string_view) { ++tokenCount; });
+
+    if (inputPath.empty()) {
+        printf("corpus: %llu tokens, vocabulary %zu, zipf %.2f, seed %llu, %.1f MB\n",
+               (unsigned long long)corpusOptions.tokenCount, corpusOptions.vocabularySize, corpusOptions.zipfExponent,
+               (unsigned long long)corpusOptions.seed, input.size() / 1e6);
+    } else {
+        printf("input: %s, %llu tokens, %.1f MB\n", inputPath.c_str(), (unsigned long long)tokenCount,
+               input.size() / 1e6);
+    }
+    printf("threads: %zu, repeat: %d\n\n", threadCount, repeatCount);
+
+    // Step 2: Time the current pipeline, keeping the fastest run of each stage
+    StageTimes fastest;
+    for (int run = 0; run < repeatCount; ++run) {
+        fastest.keepFastest(runPipeline(load, threadCount, expected));
+    }
+    printTimes("current pipeline", fastest, input.size(), tokenCount);
+
+    // Step 3: Time the original implementation
+    if (baseline) {
+        StageTimes baselineFastest;
+        for (int run = 0; run < repeatCount; ++run) {
+            baselineFastest.keepFastest(runBaseline(load, expected));
+        }
+        printf("\n");
+        printTimes("baseline (original main)", baselineFastest, input.size(), tokenCount);
+    }
+
+    printf("\npeak RSS: %.1f MB\n", peakResidentBytes() / 1e6);
+    bool verified = fastest.verified;
+
+    // Step 4: Save the stage throughputs or hold them against saved ones
+    if (!recordPath.empty() && !recordThroughput(recordPath, fastest, input.size(), tokenCount, threadCount)) {
+        return 1;
+    }
+    if (!comparePath.empty() &&
+        compareThroughput(comparePath, fastest, input.size(), tokenCount, threadCount, maxSlowdown) != 0) {
+        return 1;
+    }
+    return verified ? 0 : 1;
+}
+
+/*
+ * CODE DOCUMENTATION
+ * Project: Text Frequency and Encoding (benchmark)
+ *
+ * Overview:
+ * This program times the stages of the encoder on a reproducible corpus so that performance
+ * changes can be measured and compared with the original implementation.
+ *
+ * Implementation Highlights:
+ * - The Zipf corpus is generated from a seeded mt19937_64 and a cumulative weight table, so the
+ *   same options always produce the same bytes; `--generate` writes it out for other tools.
+ * - The current pipeline is built from the same headers as `project5` (token_scanner.h,
+ *   token_table.h, parallel_count.h, output_writer.h, text_codec.h), stage by stage.
+ * - The baseline reproduces the original `main()` of project5.cpp stage by stage.
+ * - The write stage goes to a temporary file so terminal or pipe speed does not skew it.
+ * - Every run decodes its own output and compares it with the input tokens; a mismatch is
+ *   flagged in the report and makes the program exit with status 1.
+ * - Peak RSS comes from getrusage on POSIX and GetProcessMemoryInfo on Windows.
+ * - `--check` takes the original implementation's dictionary and positions as the reference and
+ *   names the input (seed and case index for random ones) and the path of every mismatch, so a
+ *   failure can be reproduced with the same --seed.
+ * - Throughput files are plain text (input size, token count, thread count, then MB/s per stage);
+ *   `--compare` refuses a file recorded for another input or thread count.
+ */
@@ -18,113 +18,618 @@
  * - Encoding the original text into positional representations.
  * - Decoding the encoded data back to reconstruct the original input text.
  * 
+ * Usage:
+ *   project5_decompress < input.txt                Encode and immediately decode raw text (default)
+ *   project5_decompress --decode < encoded.txt     Decode the output of `project5` (text or --binary)
+ *   project5_decompress --decode encoded.txt       Same, memory-mapping the encoded file
+ *   project5_decompress --decode --raw-ids < encoded.raw   Decode the output of `project5 --raw-ids`
+ *   project5_decompress --decode --threads N --offset N --limit N encoded.bin
+ *                                                  Decode a token range of a framed container,
+ *                                                  one frame per thread
+ *   project5_decompress --decode --dict-in FILE < encoded.txt
+ *                                                  Decode the output of `project5 --dict-in FILE`
+ *   project5_decompress --decode --online < encoded.txt
+ *                                                  Decode the output of `project5 --online`
+ *   project5_decompress --lossless < input.txt     Encode and decode keeping the original whitespace
+ *                                                  (the output is identical to the input)
+ *   project5_decompress --stats < input.txt        Also write stage times and counters as JSON
+ *                                                  to stderr (works with every mode)
+ * 
  * Full code documentation and LLM and AI assistance details are provided at the end of the code.
  */
 
 #include <iostream>
 #include <string>
-#include <unordered_map>
-#include <map>
+#include <string_view>
 #include <vector>
 #include <algorithm>
-#include <cctype>
-#include <sstream>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "async_pipeline.h"
+#include "dictionary_file.h"
+#include "encoded_format.h"
+#include "mapped_file.h"
+#include "online_model.h"
+#include "output_writer.h"
+#include "parallel_count.h"
+#include "stage_stats.h"
+#include "text_codec.h"
+#include "token_scanner.h"
+#include "token_table.h"
 
 using namespace std;
 
-// Helper function to add tokens to the frequency map
-void addToken(unordered_map<string, int> &tokenFrequency, const string &token) {
-    if (!token.empty()) {
-        tokenFrequency[token]++;
+// Size of each read from standard input when decoding
+const size_t DECODE_CHUNK_SIZE = 1 << 20;
+
+// Helper function to write one decoded token, separating tokens with single spaces
+void emitText(OutputWriter &writer, string_view token, size_t &decodedCount) {
+    if (decodedCount++ > 0) {
+        writer.put(' '); // Add a space between words
     }
+    writer.write(token);
 }
 
-// Function to process tokens and encode text
-void processToken(const map<string, int> &tokenPosition, const string &token, vector<int> &encodedText) {
-    if (!token.empty()) {
-        auto it = tokenPosition.find(token);
-        if (it != tokenPosition.end()) {
-            encodedText.push_back(it->second);
-        } else {
-            cerr << "Error: Token '" << token << "' not found in tokenPosition map." << endl;
+// Helper function to write the token at a position
+// Looks the position up in the rank -> token table
+bool emitToken(OutputWriter &writer, const vector<string_view> &tokens, uint64_t position, size_t &decodedCount) {
+    if (position == 0 || position > tokens.size()) {
+        cerr << "Error: Invalid position " << position << endl;
+        return false;
+    }
+    emitText(writer, tokens[position - 1], decodedCount);
+    return true;
+}
+
+// Helper function to finish the decoded output and report write errors
+// Lossless output ends exactly like the input did, so it gets no newline
+int finishDecodedOutput(OutputWriter &writer, bool newline = true) {
+    if (newline) {
+        writer.put('\n');
+    }
+    if (!writer.flush()) {
+        cerr << "Error: Failed to write the decoded output." << endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Options for the standalone decoder
+struct DecodeOptions {
+    size_t threadCount = 1;       // Threads decoding frames of a framed container
+    uint64_t offset = 0;          // Index of the first token to output
+    uint64_t limit = UINT64_MAX;  // Maximum number of tokens to output
+    const DictionaryFile *dictionary = nullptr; // Saved dictionary given with --dict-in
+    bool online = false;                        // Input is from `project5 --online`
+};
+
+// Decoder for the binary container written by `project5 --binary`, `--framed` or `--huffman`
+// Framed containers are decoded a batch of frames at a time, one frame per thread, and can start
+// at any token through the frame index; plain and lossless containers are decoded and written
+// a block at a time
+int decodeContainer(string_view encoded, const DecodeOptions &options) {
+    STATS_TIMER("decode");
+    ByteReader reader(encoded);
+    ContainerHeader header;
+    string errorMessage;
+    if (!readContainerHeader(reader, header, errorMessage)) {
+        cerr << "Error: " << errorMessage << endl;
+        return 1;
+    }
+    HuffmanDecoder huffman;
+    if ((header.flags & CONTAINER_FLAG_HUFFMAN) && !huffman.build(header.codeLengthCounts)) {
+        cerr << "Error: Invalid Huffman code table." << endl;
+        return 1;
+    }
+    vector<string_view> savedTokens; // Rank -> token table of an external dictionary
+    const vector<string_view> *tokenTable;
+    if (!selectContainerTokens(header, options.dictionary, savedTokens, tokenTable, errorMessage)) {
+        cerr << "Error: " << errorMessage << endl;
+        return 1;
+    }
+    TokenBlob tokens; // Shared read-only by the frame threads
+    tokens.assign(*tokenTable);
+    uint64_t first = min(options.offset, header.idCount);
+    uint64_t last = first + min(options.limit, header.idCount - first);
+    STATS_ADD("tokens", last - first);
+    STATS_ADD("dictionary_tokens", tokens.size());
+
+    OutputWriter writer;
+    writer.startBackgroundWrites(); // Frames are decoded while the previous output is written
+    size_t decodedCount = 0;
+    bool lossless = (header.flags & CONTAINER_FLAG_SEPARATORS) != 0;
+    if (lossless || (header.flags & CONTAINER_FLAG_FRAMED) == 0) {
+        // Decode a block at a time and write each block out, so memory does not grow with the output
+        if (lossless) {
+            writer.setBinary(); // Keep the separators exactly as they were
+        }
+        ContainerRangeDecoder range(header, tokens, huffman, encoded, reader.position(), encoded.size(), first,
+                                    last - first);
+        string block;
+        while (!range.finished()) {
+            block.clear();
+            if (!range.next(block, errorMessage)) {
+                cerr << "Error: " << errorMessage << endl;
+                return 1;
+            }
+            if (!lossless && !block.empty() && decodedCount++ > 0) {
+                writer.put(' ');
+            }
+            writer.write(block);
+        }
+        return finishDecodedOutput(writer, !lossless);
+    }
+
+    vector<FrameEntry> frames;
+    size_t indexStart;
+    if (!readFrameIndex(encoded, reader.position(), frames, indexStart, errorMessage)) {
+        cerr << "Error: " << errorMessage << endl;
+        return 1;
+    }
+    vector<uint64_t> frameFirstToken(frames.size() + 1, 0); // Prefix sum of frame token counts
+    for (size_t f = 0; f < frames.size(); ++f) {
+        frameFirstToken[f + 1] = frameFirstToken[f] + frames[f].tokenCount;
+    }
+    if (frameFirstToken.back() != header.idCount) {
+        cerr << "Error: Frame index does not cover the position count." << endl;
+        return 1;
+    }
+
+    // Seek to the frame holding the first requested token
+    size_t frame = (size_t)(upper_bound(frameFirstToken.begin(), frameFirstToken.end(), first) -
+                            frameFirstToken.begin()) - 1;
+    size_t threadCount = max<size_t>(1, options.threadCount);
+    vector<string> frameTexts(threadCount);
+    vector<string> frameErrors(threadCount);
+    while (frame < frames.size() && frameFirstToken[frame] < last) {
+        size_t batchSize = min(threadCount, frames.size() - frame);
+        runPerChunk(batchSize, [&](size_t k) {
+            size_t f = frame + k;
+            uint64_t skip = first > frameFirstToken[f] ? first - frameFirstToken[f] : 0;
+            uint64_t end = min(last, frameFirstToken[f + 1]);
+            uint64_t take = end > frameFirstToken[f] + skip ? end - frameFirstToken[f] - skip : 0;
+            size_t frameEnd = f + 1 < frames.size() ? (size_t)frames[f + 1].byteOffset : indexStart;
+            frameTexts[k].clear();
+            frameErrors[k].clear();
+            decodeRange(header, tokens, huffman, encoded, (size_t)frames[f].byteOffset, frameEnd, skip, take,
+                        frameTexts[k], frameErrors[k]);
+        });
+        for (size_t k = 0; k < batchSize; ++k) {
+            if (!frameErrors[k].empty()) {
+                cerr << "Error: " << frameErrors[k] << " (frame " << frame + k << ")" << endl;
+                return 1;
+            }
+            if (!frameTexts[k].empty()) {
+                if (decodedCount++ > 0) {
+                    writer.put(' ');
+                }
+                writer.write(frameTexts[k]);
+            }
         }
+        frame += batchSize;
     }
+    return finishDecodedOutput(writer);
 }
 
-int main() {
-    // Step 1: Read all input from standard input into a single string
-    string inputContent((istreambuf_iterator<char>(cin)), istreambuf_iterator<char>());
-
-    // Step 2: Calculate token frequencies
-    unordered_map<string, int> tokenFrequency;
-    string token;
-    char aChar;
-    istringstream inputStream(inputContent);
-    while (inputStream.get(aChar)) {
-        if (isspace(aChar)) {
-            addToken(tokenFrequency, token);
-            token.clear();
-        } else {
-            token += aChar;
-        }
-    }
-    addToken(tokenFrequency, token); // Process the last token
-
-    // Step 3: Transfer data to a vector for sorting
-    vector<pair<string, int>> sortedTokens(tokenFrequency.begin(), tokenFrequency.end());
-    sort(sortedTokens.begin(), sortedTokens.end(),
-         [](const pair<string, int> &a, const pair<string, int> &b) {
-             if (a.second != b.second) {
-                 return a.second > b.second; // Sort by frequency (descending)
-             }
-             return a.first < b.first; // Lexicographical order for tie-breaking
-         });
-
-    // Step 4: Map tokens to their positions in the sorted order
-    map<string, int> tokenPosition;
-    int position = 1;
-    for (const auto &pair : sortedTokens) {
-        tokenPosition[pair.first] = position++;
-    }
-
-    // Step 5: Encode the text based on token positions
-    vector<int> encodedText;
-    token.clear();
-    istringstream secondPass(inputContent);
-    while (secondPass.get(aChar)) {
-        if (isspace(aChar)) {
-            processToken(tokenPosition, token, encodedText);
-            token.clear();
+// Incremental decoder for the text formats written by `project5` and `project5 --raw-ids`
+// The input is fed in chunks of any size: the dictionary line is kept (it becomes the
+// rank -> token table), and positions are decoded and written as soon as they are complete.
+// An empty dictionary line means the positions refer to the saved dictionary, if one is given;
+// `project5 --dict-in` records that dictionary's token count and fingerprint on the separator
+// line, and they must match the --dict-in file.
+// Online streams start with an empty dictionary and rebuild it at every "-" marker, mirroring
+// the encoder's OnlineRankModel.
+class TextFormatDecoder {
+public:
+    TextFormatDecoder(OutputWriter &writer, bool rawIds, const DictionaryFile *dictionary, bool online)
+        : writer(writer), rawIds(rawIds), online(online), dictionary(dictionary) {}
+
+    bool feed(const char *data, size_t length) {
+        size_t i = 0;
+        while (i < length && stage != Stage::Positions) {
+            const char *newline = (const char *)memchr(data + i, '\n', length - i);
+            size_t lineEnd = newline == nullptr ? length : (size_t)(newline - data);
+            currentLine.append(data + i, lineEnd - i);
+            if (newline == nullptr) {
+                return true; // The line continues in the next chunk
+            }
+            i = lineEnd + 1;
+            if (!finishLine()) {
+                return false;
+            }
+        }
+        return rawIds ? feedRawPositions(data + i, length - i) : feedTextPositions(data + i, length - i);
+    }
+
+    bool finish() {
+        if (stage != Stage::Positions) {
+            cerr << "Error: Missing dictionary or separator line." << endl;
+            return false;
+        }
+        if (rawIds && (rawCarryLength != 0 || rawStage != RawStage::Position)) {
+            cerr << "Error: Truncated raw position stream." << endl;
+            return false;
+        }
+        if (inNumber && pendingPosition == 0) {
+            inLiteral = true; // A final "0" is an escape with no token
+        }
+        if (inLiteral) { // The last token was a literal that ran up to the end
+            inLiteral = false;
+            return emitLiteral();
+        }
+        if (inNumber) { // The last position was not followed by whitespace
+            inNumber = false;
+            return emitPosition(pendingPosition);
+        }
+        return true;
+    }
+
+    // Records the decoded token count and the dictionary size for --stats
+    void recordStats() const {
+        STATS_ADD("tokens", decodedCount);
+        STATS_ADD("dictionary_tokens", online ? onlineModel.tokens().size() : tokens.size());
+        if (online) {
+            STATS_TABLE(onlineModel.table());
+        }
+    }
+
+private:
+    enum class Stage { Dictionary, Separator, Positions };
+    enum class RawStage { Position, LiteralLength, LiteralBytes };
+
+    bool finishLine() {
+        if (!currentLine.empty() && currentLine.back() == '\r') {
+            currentLine.pop_back(); // Tolerate output that went through CRLF translation
+        }
+        if (stage == Stage::Dictionary) {
+            dictionaryLine.swap(currentLine);
+            forEachToken(dictionaryLine.data(), dictionaryLine.size(),
+                         [this](string_view token) { tokens.push_back(token); });
+            if (tokens.empty() && dictionary != nullptr) {
+                tokens = dictionary->tokens(); // Encoded with --dict-in
+            }
+            stage = Stage::Separator;
         } else {
-            token += aChar;
+            if (currentLine.compare(0, 11, "********** ") == 0) { // Encoded with --dict-in
+                if (!checkDictionaryReference(string_view(currentLine).substr(11))) {
+                    return false;
+                }
+            } else if (currentLine != "**********") {
+                cerr << "Error: Expected the ********** separator line after the dictionary." << endl;
+                return false;
+            }
+            stage = Stage::Positions;
         }
+        currentLine.clear();
+        return true;
     }
-    processToken(tokenPosition, token, encodedText); // Process the last token
 
-    // Step 6: Decode the encoded text
-    vector<string> tokens; // Vector to store tokens in sorted order
-    for (const auto &pair : sortedTokens) {
-        tokens.push_back(pair.first);
+    // Checks the saved dictionary's token count and fingerprint from the separator line
+    bool checkDictionaryReference(string_view reference) {
+        if (dictionary == nullptr) {
+            cerr << "Error: This input was encoded against a saved dictionary; pass it with --dict-in." << endl;
+            return false;
+        }
+        string fields(reference);
+        char *end;
+        uint64_t tokenCount = strtoull(fields.c_str(), &end, 10);
+        char *fingerprintEnd;
+        uint64_t fingerprint = strtoull(end, &fingerprintEnd, 10);
+        if (end == fields.c_str() || fingerprintEnd == end || *fingerprintEnd != '\0' || !dictionaryLine.empty()) {
+            cerr << "Error: Invalid saved dictionary reference on the separator line." << endl;
+            return false;
+        }
+        if (dictionary->size() != tokenCount || dictionary->fingerprint() != fingerprint) {
+            cerr << "Error: The --dict-in dictionary is not the one this input was encoded with." << endl;
+            return false;
+        }
+        return true;
     }
 
-    stringstream decodedText;
-    for (size_t i = 0; i < encodedText.size(); ++i) {
-        int position = encodedText[i];
-        if (position > 0 && position <= tokens.size()) {
-            decodedText << tokens[position - 1];
-            if (i < encodedText.size() - 1) {
-                decodedText << " "; // Add a space between words
+    // Writes the token at a position (and counts it in online mode)
+    bool emitPosition(uint64_t position) {
+        if (!emitToken(writer, tokens, position, decodedCount)) {
+            return false;
+        }
+        if (online) {
+            onlineModel.observe(tokens[position - 1]);
+        }
+        return true;
+    }
+
+    // Writes the escaped token collected in `literal`
+    bool emitLiteral() {
+        if (literal.empty()) {
+            cerr << "Error: Escape without a token." << endl;
+            return false;
+        }
+        emitText(writer, literal, decodedCount);
+        if (online) {
+            onlineModel.observe(literal);
+        }
+        literal.clear();
+        return true;
+    }
+
+    bool feedTextPositions(const char *data, size_t length) {
+        for (size_t i = 0; i < length; ++i) {
+            char aChar = data[i];
+            if (inLiteral) { // The token after an escape, up to the next whitespace
+                if (!isTokenSpace(aChar)) {
+                    literal += aChar;
+                } else if (!literal.empty()) {
+                    inLiteral = false;
+                    emitLiteral();
+                }
+                continue;
+            }
+            if (aChar >= '0' && aChar <= '9') {
+                pendingPosition = pendingPosition * 10 + (uint64_t)(aChar - '0');
+                if (pendingPosition > tokens.size()) {
+                    cerr << "Error: Invalid position " << pendingPosition << endl;
+                    return false;
+                }
+                inNumber = true;
+            } else if (isTokenSpace(aChar)) {
+                if (inNumber && pendingPosition == 0) {
+                    inLiteral = true; // Escape: the token itself follows
+                } else if (inNumber && !emitPosition(pendingPosition)) {
+                    return false;
+                }
+                inNumber = false;
+                pendingPosition = 0;
+            } else if (online && aChar == '-' && !inNumber) { // Rebuild marker
+                onlineModel.rebuild();
+                tokens = onlineModel.tokens();
+            } else {
+                cerr << "Error: Unexpected character in the position list." << endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool feedRawPositions(const char *data, size_t length) {
+        for (size_t i = 0; i < length; ++i) {
+            if (rawStage == RawStage::LiteralBytes) { // Bytes of an escaped token
+                size_t take = min(length - i, literalRemaining);
+                literal.append(data + i, take);
+                i += take - 1;
+                literalRemaining -= take;
+                if (literalRemaining == 0) {
+                    rawStage = RawStage::Position;
+                    if (!emitLiteral()) {
+                        return false;
+                    }
+                }
+                continue;
+            }
+            rawCarry[rawCarryLength++] = (unsigned char)data[i];
+            if (rawCarryLength == 4) {
+                uint32_t value = (uint32_t)rawCarry[0] | (uint32_t)rawCarry[1] << 8 |
+                                 (uint32_t)rawCarry[2] << 16 | (uint32_t)rawCarry[3] << 24;
+                rawCarryLength = 0;
+                if (rawStage == RawStage::LiteralLength) {
+                    literalRemaining = value;
+                    rawStage = RawStage::LiteralBytes;
+                    if (value == 0 && !emitLiteral()) {
+                        return false; // Reports the empty escape
+                    }
+                } else if (value == 0) {
+                    rawStage = RawStage::LiteralLength; // Escape: length and bytes follow
+                } else if (!emitPosition(value)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    OutputWriter &writer;
+    bool rawIds;
+    bool online;
+    const DictionaryFile *dictionary;
+    OnlineRankModel onlineModel; // Online streams: the encoder's adaptive ranking
+    Stage stage = Stage::Dictionary;
+    string currentLine;          // Header line being assembled across chunks
+    string dictionaryLine;       // Storage behind the rank -> token table
+    vector<string_view> tokens;  // Rank -> token (position - 1 indexes it)
+    uint64_t pendingPosition = 0;
+    bool inNumber = false;
+    unsigned char rawCarry[4];
+    size_t rawCarryLength = 0;
+    RawStage rawStage = RawStage::Position;
+    bool inLiteral = false;      // Text positions: reading the token after an escape
+    string literal;              // Escaped token being assembled across chunks
+    size_t literalRemaining = 0; // Raw positions: bytes of the escaped token still to read
+    size_t decodedCount = 0;
+};
+
+// Standalone decoder for the output of `project5`
+// Mapped files and binary containers are decoded from one buffer; text read from standard
+// input is decoded chunk by chunk, so only the dictionary stays resident. A reader thread reads
+// the next chunks and a writer thread writes the decoded text while a chunk is decoded.
+int decodeEncodedInput(const string &inputPath, bool rawIds, const DecodeOptions &options) {
+    OutputWriter writer;
+    writer.startBackgroundWrites();
+    TextFormatDecoder textDecoder(writer, rawIds, options.dictionary, options.online);
+
+    if (!inputPath.empty()) {
+        MappedFile mappedInput;
+        string errorMessage;
+        if (!mappedInput.open(inputPath, errorMessage)) {
+            cerr << "Error: " << errorMessage << endl;
+            return 1;
+        }
+        string_view encoded = mappedInput.view();
+        STATS_ADD("bytes_read", encoded.size());
+        if (isContainer(encoded)) {
+            return decodeContainer(encoded, options);
+        }
+        STATS_TIMER("decode");
+        if (!textDecoder.feed(encoded.data(), encoded.size()) || !textDecoder.finish()) {
+            return 1;
+        }
+        textDecoder.recordStats();
+        return finishDecodedOutput(writer);
+    }
+
+    ChunkReader reader(stdin, DECODE_CHUNK_SIZE);
+    string_view chunk;
+    bool more = reader.next(chunk);
+    STATS_ADD("bytes_read", chunk.size());
+    if (isContainer(chunk)) {
+        // The container is parsed from one buffer, so read the rest of it too
+        string encodedContent(chunk);
+        {
+            STATS_TIMER("read");
+            while (reader.next(chunk)) {
+                STATS_ADD("bytes_read", chunk.size());
+                encodedContent.append(chunk.data(), chunk.size());
+            }
+        }
+        if (reader.failed()) {
+            cerr << "Error: Failed to read standard input." << endl;
+            return 1;
+        }
+        return decodeContainer(encodedContent, options);
+    }
+    STATS_TIMER("read_decode"); // Chunks are decoded as they are read
+    while (more) {
+        if (!textDecoder.feed(chunk.data(), chunk.size())) {
+            return 1;
+        }
+        more = reader.next(chunk);
+        STATS_ADD("bytes_read", more ? chunk.size() : 0);
+    }
+    if (reader.failed()) {
+        cerr << "Error: Failed to read standard input." << endl;
+        return 1;
+    }
+    if (!textDecoder.finish()) {
+        return 1;
+    }
+    textDecoder.recordStats();
+    return finishDecodedOutput(writer);
+}
+
+int main(int argc, char *argv[]) {
+    // Parse command-line options
+    bool decodeMode = false;
+    bool rawIds = false;
+    bool lossless = false; // Self-test: keep the whitespace between tokens
+    DecodeOptions decodeOptions;
+    string inputPath; // Empty means read from standard input
+    string dictionaryInPath;
+    StatsReport statsReport("project5_decompress"); // --stats: writes the JSON report when main returns
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--decode") == 0) {
+            decodeMode = true;
+        } else if (strcmp(argv[i], "--raw-ids") == 0) {
+            rawIds = true;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            decodeOptions.threadCount = strtoul(argv[++i], nullptr, 10);
+            if (decodeOptions.threadCount == 0) {
+                decodeOptions.threadCount = max(1u, thread::hardware_concurrency()); // 0 means one per core
             }
+        } else if (strcmp(argv[i], "--offset") == 0 && i + 1 < argc) {
+            decodeOptions.offset = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--limit") == 0 && i + 1 < argc) {
+            decodeOptions.limit = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--online") == 0) {
+            decodeOptions.online = true;
+            decodeMode = true;
+        } else if (strcmp(argv[i], "--dict-in") == 0 && i + 1 < argc) {
+            dictionaryInPath = argv[++i];
+        } else if (strcmp(argv[i], "--lossless") == 0) {
+            lossless = true;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            runStats().enabled = true;
+        } else if (argv[i][0] != '-' && inputPath.empty()) {
+            inputPath = argv[i];
         } else {
-            cerr << "Error: Invalid position " << position << endl;
+            cerr << "Error: Unknown option '" << argv[i] << "'." << endl;
+            cerr << "Usage: " << argv[0] << " [--decode [--raw-ids] [--threads N] [--offset N] [--limit N]"
+                 << " [--dict-in FILE] [--online] [encoded.txt] | --lossless] [--stats] < input.txt" << endl;
             return 1;
         }
     }
 
-    // Output the final decoded text
-    cout << decodedText.str() << endl;
+    DictionaryFile dictionary;
+    if (!dictionaryInPath.empty()) {
+        string errorMessage;
+        if (!dictionary.open(dictionaryInPath, errorMessage)) {
+            cerr << "Error: " << errorMessage << endl;
+            return 1;
+        }
+        decodeOptions.dictionary = &dictionary;
+        decodeMode = true;
+    }
 
-    return 0;
+    if (decodeMode || rawIds || !inputPath.empty()) {
+        return decodeEncodedInput(inputPath, rawIds, decodeOptions);
+    }
+
+    // Step 1: Read all input from standard input into a single string
+    string inputContent;
+    {
+        STATS_TIMER("read");
+#ifdef _WIN32
+        if (lossless) {
+            _setmode(_fileno(stdin), _O_BINARY); // Keep CR bytes, they are part of the separators
+        }
+#endif
+        if (!readWholeFile(stdin, inputContent)) {
+            cerr << "Error: Failed to read standard input." << endl;
+            return 1;
+        }
+    }
+    STATS_ADD("bytes_read", inputContent.size());
+
+    // Step 2 to 5: Count, sort and encode with the library encoder (text_codec.h)
+    // Tokens are views into inputContent, no copies
+    Encoder encoder;
+    encoder.keepSeparators(lossless);
+    {
+        STATS_TIMER("count");
+        encoder.encode(inputContent);
+    }
+    {
+        STATS_TIMER("sort_encode");
+        encoder.finish();
+    }
+    STATS_ADD("tokens", encoder.positions().size());
+    STATS_TABLE(encoder.table());
+
+    // Step 6: Decode the encoded text with the encoder's dictionary
+    Decoder decoder;
+    decoder.setDictionary(encoder.dictionary());
+    string decodedText;
+    string errorMessage;
+    {
+        STATS_TIMER("decode");
+        const vector<int> &positions = encoder.positions();
+        bool decoded = lossless ? decoder.decodeLossless(positions.data(), positions.size(), encoder.separators(),
+                                                         decodedText, errorMessage)
+                                : decoder.decode(positions.data(), positions.size(), decodedText, errorMessage);
+        if (!decoded) {
+            cerr << "Error: " << errorMessage << endl;
+            return 1;
+        }
+    }
+
+    // Output the decoded text
+    STATS_TIMER("write");
+    OutputWriter writer;
+    if (lossless) {
+        writer.setBinary();
+    }
+    writer.write(decodedText);
+    return finishDecodedOutput(writer, !lossless);
 }
 
 /*
@@ -144,9 +649,38 @@ int main() {
  * - **Decoding**: Reconstructs the original text from the encoded positional representation.
  *
  * Implementation Highlights:
- * - Utilizes `unordered_map` for efficient frequency calculation.
- * - Leverages `vector` and `map` for sorting and positional encoding.
+ * - Interns each token once into a dense provisional id (token_table.h) and records the id sequence.
+ * - Sorts the provisional ids and encodes through a flat id-to-position remap array.
+ * - Finds token boundaries 64 bytes at a time with a runtime-selected SIMD whitespace scanner
+ *   (AVX2/SSE2/NEON, scalar fallback) that matches `isspace` in the C locale.
  * - Handles input dynamically via `std::cin` for compatibility with redirected input.
+ * - `--decode` is a standalone decoder for the encoder's output: the dictionary line becomes an
+ *   O(1) position -> token table, positions are decoded chunk by chunk, and the binary
+ *   container (encoded_format.h) is detected by its magic bytes.
+ * - Plain varint containers and the self-test decode through a block kernel (decode_kernel.h):
+ *   the dictionary is one byte blob with an offset table, positions are unpacked and
+ *   range-checked a block at a time, and token bytes are bulk-copied into one output buffer.
+ * - Huffman-coded containers (`project5 --huffman`) are decoded with a table-driven canonical
+ *   decoder (entropy_coder.h) that resolves most codes with one lookup.
+ * - Framed containers (`project5 --framed`) are decoded through their frame index: `--offset`
+ *   seeks straight to the frame holding that token and `--threads` decodes frames in parallel.
+ * - `--dict-in` decodes output encoded against a saved dictionary (dictionary_file.h), which is
+ *   memory-mapped and checked against the fingerprint in the container or on the separator
+ *   line of the text formats; escaped tokens are copied through as they are.
+ * - `--online` decodes the adaptive stream of `project5 --online` by replaying the encoder's
+ *   rank rebuilds (online_model.h) at the in-band "-" markers.
+ * - The encode/decode self-test runs on the reusable in-process `Encoder` and `Decoder`
+ *   (text_codec.h), which also hold the container position decoders used by `--decode`.
+ * - Lossless containers (`project5 --lossless`) interleave the positions with the run-length
+ *   coded separator stream (separator_stream.h), restoring every space, tab and newline; the
+ *   output gets no extra newline. `--lossless` on the self-test does the same in memory.
+ * - `--stats` writes stage times, bytes read, token and dictionary counts and peak RSS as JSON to
+ *   stderr (stage_stats.h); the encode/decode self-test also reports the intern table's load
+ *   factor, probe length and arena bytes.
+ * - Decoded text is streamed through a buffered writer (output_writer.h) instead of being
+ *   collected in a stringstream. When decoding, a writer thread writes full buffers while the
+ *   next positions are decoded, and standard input is read ahead on a reader thread into a small
+ *   ring of chunk buffers (async_pipeline.h).
  *
  * LLM and GitHub Copilot Usage Documentation:
  *
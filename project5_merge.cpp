@@ -0,0 +1,154 @@
+/*
+ * Program Name: Text Encoding Count Merger
+ *
+ * Description:
+ * This program merges the partial token frequency tables that `project5 --counts-out` writes
+ * on every machine of a cluster into one global ranking. The ranking is saved as a dictionary
+ * file, and every machine then encodes its own shard against it with `project5 --dict-in`, so
+ * the counting scales out without the raw text ever leaving the machine it is on.
+ *
+ * The partial tables are sorted by token bytes (partial_counts.h), so they are merged in one
+ * k-way pass that holds a single token of each table in memory. The merged counts are ranked
+ * exactly like the encoder ranks its own counts (frequency descending, then token bytes), so
+ * the dictionary is the same one `project5 --dict-out` would save for the whole corpus.
+ *
+ * Usage:
+ *   project5_merge --dict-out global.dict node1.counts node2.counts ...
+ *                            Merge the tables and save the global ranking as a dictionary file
+ *   project5_merge --counts-out merged.counts node1.counts node2.counts ...
+ *                            Merge the tables into another partial table (for merge trees that
+ *                            combine racks or regions first); combines with --dict-out
+ *   project5_merge --stats ...  Also write stage times and counters as JSON to stderr
+ *
+ * Build: g++ -std=c++17 -O2 -pthread project5_merge.cpp -o project5_merge
+ *        (add -lpsapi when building with MinGW on Windows)
+ */
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "dictionary_file.h"
+#include "partial_counts.h"
+#include "stage_stats.h"
+#include "token_arena.h"
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+    // Parse command-line options
+    string dictionaryOutPath, countsOutPath;
+    vector<string> inputPaths;
+    StatsReport statsReport("project5_merge"); // --stats: writes the JSON report when main returns
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--dict-out") == 0 && i + 1 < argc) {
+            dictionaryOutPath = argv[++i];
+        } else if (strcmp(argv[i], "--counts-out") == 0 && i + 1 < argc) {
+            countsOutPath = argv[++i];
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            runStats().enabled = true;
+        } else if (argv[i][0] != '-') {
+            inputPaths.push_back(argv[i]);
+        } else {
+            cerr << "Error: Unknown option '" << argv[i] << "'." << endl;
+            cerr << "Usage: " << argv[0] << " [--dict-out FILE] [--counts-out FILE] [--stats] table.counts..." << endl;
+            return 1;
+        }
+    }
+    if (inputPaths.empty() || (dictionaryOutPath.empty() && countsOutPath.empty())) {
+        cerr << "Error: Give at least one partial count table and --dict-out and/or --counts-out." << endl;
+        return 1;
+    }
+
+    // Step 1: Open every partial table
+    string errorMessage;
+    vector<PartialCountsReader> tables(inputPaths.size());
+    for (size_t i = 0; i < inputPaths.size(); ++i) {
+        if (!tables[i].open(inputPaths[i], errorMessage)) {
+            cerr << "Error: " << errorMessage << endl;
+            return 1;
+        }
+        STATS_ADD("input_tokens", tables[i].size());
+        STATS_ADD("occurrences", tables[i].occurrenceCount());
+    }
+
+    // Step 2: Merge the tables in token order, adding up the counts of equal tokens
+    TokenArena arena;             // Bytes of the merged tokens
+    vector<string_view> tokens;   // Merged tokens in byte order
+    vector<uint64_t> counts;      // Their global counts
+    {
+        STATS_TIMER("merge");
+        bool merged = mergePartialCounts(tables, [&](string_view token, uint64_t count) {
+            tokens.push_back(arena.store(token));
+            counts.push_back(count);
+        }, errorMessage);
+        if (!merged) {
+            cerr << "Error: " << errorMessage << endl;
+            return 1;
+        }
+    }
+    STATS_ADD("distinct_tokens", tokens.size());
+
+    // Step 3: Save the merged partial table, still in token order
+    if (!countsOutPath.empty()) {
+        STATS_TIMER("save_counts");
+        if (!writePartialCounts(countsOutPath, tokens, counts, errorMessage)) {
+            cerr << "Error: " << errorMessage << endl;
+            return 1;
+        }
+    }
+
+    // Step 4: Rank the tokens by global frequency (descending) and by bytes for ties, and save
+    // the ranking as the dictionary every node encodes against
+    if (!dictionaryOutPath.empty()) {
+        vector<size_t> order(tokens.size());
+        vector<string_view> rankedTokens;
+        vector<uint64_t> rankedCounts;
+        {
+            STATS_TIMER("sort");
+            for (size_t i = 0; i < order.size(); ++i) {
+                order[i] = i;
+            }
+            // The tokens are already in byte order, so a stable sort on the count breaks the ties
+            stable_sort(order.begin(), order.end(), [&counts](size_t a, size_t b) { return counts[a] > counts[b]; });
+            rankedTokens.reserve(order.size());
+            rankedCounts.reserve(order.size());
+            for (size_t index : order) {
+                rankedTokens.push_back(tokens[index]);
+                rankedCounts.push_back(counts[index]);
+            }
+        }
+        STATS_TIMER("save_dictionary");
+        if (!writeDictionaryFile(dictionaryOutPath, rankedTokens, rankedCounts, errorMessage)) {
+            cerr << "Error: " << errorMessage << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * CODE DOCUMENTATION
+ * Project: Text Frequency and Encoding (distributed count merger)
+ *
+ * Overview:
+ * This program turns the token counts of many machines into the one global ranking that
+ * the encoding step needs, so a corpus can be counted where it is stored.
+ *
+ * Implementation Highlights:
+ * - Partial tables are front coded and sorted by token bytes (partial_counts.h); a binary heap
+ *   over the current token of each table merges any number of them in a single pass, and equal
+ *   tokens from different tables are added up in 64 bits.
+ * - Merged tokens are copied into a TokenArena once (token_arena.h); nothing else is allocated
+ *   per token.
+ * - The ranking needs no string compares: the merge already yields byte order, so a stable sort
+ *   on the count alone gives the encoder's (frequency descending, bytes ascending) order.
+ * - `--counts-out` writes the merged table in the same partial format, so merges can be chained
+ *   into a tree and the result is the same as one flat merge.
+ * - Corrupt or unsorted tables are rejected with the file name and entry index instead of
+ *   producing a wrong ranking.
+ */
@@ -0,0 +1,227 @@
+/*
+ * File Name: separator_stream.h
+ *
+ * Description:
+ * Whitespace between tokens for the lossless mode (`project5 --lossless`). The tokenizer
+ * normally drops the separators and the decoder puts back single spaces; in lossless mode the
+ * encoder also records every separator run so the decoder can rebuild the input byte for byte.
+ *
+ * A buffer of n tokens has n + 1 gaps: the run before the first token (often empty), the runs
+ * between tokens and the run after the last token. SeparatorRecorder takes each gap from the
+ * token views themselves (the bytes from the end of one token to the start of the next). Most
+ * gaps are a single space, and those are only counted; any other gap is interned and listed
+ * with its index. Other one-byte gaps (a newline, a tab) find their id in a table indexed by
+ * the byte, so only longer runs are hashed. After the input, the distinct runs are ranked by
+ * frequency like the tokens.
+ *
+ * The separator block of the container (CONTAINER_FLAG_SEPARATORS, encoded_format.h) holds
+ *
+ *   separatorCount   number of distinct runs
+ *   separators       separatorCount entries of (length, bytes), most frequent first
+ *   other gaps       pairs of (skip, rank), up to the end of the block: `skip` gaps hold the most
+ *                    frequent run, then one gap holds separator `rank` (1 or more); every gap
+ *                    after the last pair holds the most frequent run
+ *
+ * So text with one space between words and a newline per line costs two bytes per line.
+ */
+
+#ifndef SEPARATOR_STREAM_H
+#define SEPARATOR_STREAM_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "encoded_format.h"
+#include "output_writer.h"
+#include "token_table.h"
+
+// A gap that does not hold the most frequent separator run
+struct OtherGap {
+    uint64_t gap; // Index of the gap (gap i is in front of token i)
+    int id;       // Separator id while recording, its rank (1 or more) after finish()
+};
+
+// Records the separator runs of one buffer while it is tokenized
+class SeparatorRecorder {
+public:
+    // Starts a buffer; tokens passed to record() must be views into it, in order
+    void start(const char *begin) {
+        clear();
+        previousEnd = begin;
+    }
+
+    // Records the gap in front of the token
+    void record(std::string_view token) {
+        size_t length = (size_t)(token.data() - previousEnd);
+        if (length == 1 && *previousEnd == ' ') { // Almost every gap: only counted
+            ++spaceCount;
+        } else if (length == 1) { // Other one-byte runs skip the hash
+            int &byteId = byteIds[(unsigned char)*previousEnd];
+            if (byteId == 0) {
+                byteId = table.intern(std::string_view(previousEnd, 1)) + 1;
+            } else {
+                table.idFrequency[byteId - 1]++;
+            }
+            otherGaps.push_back({gapTotal, byteId - 1});
+        } else {
+            otherGaps.push_back({gapTotal, table.intern(std::string_view(previousEnd, length))});
+        }
+        ++gapTotal;
+        previousEnd = token.data() + token.size();
+    }
+
+    // Records the gap after the last token and ranks the separators; `end` is the end of the buffer
+    void finish(const char *end) {
+        record(std::string_view(end, 0));
+        int spaceId = spaceCount > 0 ? table.merge(" ", (int)spaceCount) : -1;
+        std::vector<int> sortedIds = sortTokenIds(table);
+        rankedSeparators.clear();
+        for (int id : sortedIds) {
+            rankedSeparators.push_back(table.token(id));
+        }
+        std::vector<int> idRank = buildPositionMap(sortedIds);
+        for (int &rank : idRank) {
+            --rank; // 0-based, so the most frequent run has rank 0
+        }
+        if (spaceId >= 0 && idRank[spaceId] == 0) { // The usual case: the listed gaps are the others
+            for (OtherGap &other : otherGaps) {
+                other.id = idRank[other.id];
+            }
+            return;
+        }
+        // Another run is more frequent than " ", so list every gap that does not hold it
+        std::vector<OtherGap> listed;
+        listed.swap(otherGaps);
+        int spaceRank = spaceId >= 0 ? idRank[spaceId] : 0; // Without spaces every gap was listed
+        size_t next = 0;
+        for (uint64_t gap = 0; gap < gapTotal; ++gap) {
+            int rank = spaceRank;
+            if (next < listed.size() && listed[next].gap == gap) {
+                rank = idRank[listed[next++].id];
+            }
+            if (rank != 0) {
+                otherGaps.push_back({gap, rank});
+            }
+        }
+    }
+
+    // Number of gaps (tokens + 1); valid after finish()
+    size_t gapCount() const { return (size_t)gapTotal; }
+
+    // Separator run with the given rank; valid after finish()
+    std::string_view separator(int rank) const { return rankedSeparators[rank]; }
+
+    // Gaps that do not hold separator(0), in order; valid after finish()
+    const std::vector<OtherGap> &otherGapList() const { return otherGaps; }
+
+    // Writes the separator block, preceded by its size in bytes; valid after finish()
+    void writeBlock(OutputWriter &writer) const {
+        uint64_t blockBytes = varintSize(rankedSeparators.size());
+        for (std::string_view separator : rankedSeparators) {
+            blockBytes += varintSize(separator.size()) + separator.size();
+        }
+        uint64_t nextGap = 0;
+        for (const OtherGap &other : otherGaps) {
+            blockBytes += varintSize(other.gap - nextGap) + varintSize((uint64_t)other.id);
+            nextGap = other.gap + 1;
+        }
+        writer.writeVarint(blockBytes);
+        writer.writeVarint(rankedSeparators.size());
+        for (std::string_view separator : rankedSeparators) {
+            writer.writeVarint(separator.size());
+            writer.write(separator);
+        }
+        nextGap = 0;
+        for (const OtherGap &other : otherGaps) {
+            writer.writeVarint(other.gap - nextGap);
+            writer.writeVarint((uint64_t)other.id);
+            nextGap = other.gap + 1;
+        }
+    }
+
+    // Forgets the previous buffer but keeps the allocations
+    void clear() {
+        table.clear();
+        otherGaps.clear();
+        rankedSeparators.clear();
+        std::fill(byteIds, byteIds + 256, 0);
+        spaceCount = 0;
+        gapTotal = 0;
+    }
+
+private:
+    TokenTable table;                               // Distinct runs other than " " (views into the buffer)
+    std::vector<OtherGap> otherGaps;                // Gaps that are not " ", then not separator(0)
+    std::vector<std::string_view> rankedSeparators; // Separator runs, most frequent first
+    int byteIds[256] = {};                          // Byte -> id + 1 of its one-byte run (0: none yet)
+    uint64_t spaceCount = 0;                        // Gaps holding a single space
+    uint64_t gapTotal = 0;                          // Gaps recorded so far
+    const char *previousEnd = nullptr;              // End of the last recorded token
+};
+
+// Reads the separator runs of a container back, one gap at a time
+class SeparatorReader {
+public:
+    // Parses the separator block (ContainerHeader::separatorBlock)
+    bool open(std::string_view block, std::string &errorMessage) {
+        reader = ByteReader(block);
+        uint64_t count;
+        if (!reader.readVarint(count) || count == 0 || count > block.size()) {
+            errorMessage = "Corrupt separator block.";
+            return false;
+        }
+        separators.clear();
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t length;
+            std::string_view separator;
+            if (!reader.readVarint(length) || !reader.readBytes(length, separator)) {
+                errorMessage = "Corrupt separator entry " + std::to_string(i) + ".";
+                return false;
+            }
+            separators.push_back(separator);
+        }
+        if (!readNextGap()) {
+            errorMessage = "Corrupt separator block.";
+            return false;
+        }
+        return true;
+    }
+
+    // Reads the separator run of the next gap; false if the block is corrupt
+    bool next(std::string_view &separator) {
+        if (skipLeft > 0) {
+            --skipLeft;
+            separator = separators[0];
+            return true;
+        }
+        separator = other;
+        return readNextGap();
+    }
+
+private:
+    // Reads the next (skip, rank) pair; past the last pair every gap holds separators[0]
+    bool readNextGap() {
+        if (reader.remaining() == 0) {
+            skipLeft = UINT64_MAX;
+            return true;
+        }
+        uint64_t rank;
+        if (!reader.readVarint(skipLeft) || !reader.readVarint(rank) || rank == 0 || rank >= separators.size()) {
+            return false;
+        }
+        other = separators[rank];
+        return true;
+    }
+
+    ByteReader reader{std::string_view()};
+    std::vector<std::string_view> separators;
+    std::string_view other; // Run of the next listed gap
+    uint64_t skipLeft = 0;  // Gaps holding separators[0] before it
+};
+
+#endif // SEPARATOR_STREAM_H
@@ -0,0 +1,192 @@
+/*
+ * File Name: stage_stats.h
+ *
+ * Description:
+ * Run statistics for `--stats`: wall time per pipeline stage, named counters, intern table
+ * health (load factor, probe length, arena bytes) and peak resident memory, written to stderr
+ * as one JSON object when the program exits.
+ *
+ * Code records statistics through the hooks below. They do nothing until `--stats` enables the
+ * process-wide RunStats, and compiling with -DP5_NO_STATS removes them entirely:
+ *
+ *   STATS_TIMER("sort");            Adds the time until the end of the scope to stage "sort"
+ *   STATS_ADD("tokens", count);     Adds to counter "tokens"
+ *   STATS_TABLE(table);             Records the intern table counters
+ *
+ * Stages and counters keep the order they were first recorded in. Recording is mutex-guarded,
+ * so worker threads can use the hooks too (their stage times add up).
+ */
+
+#ifndef STAGE_STATS_H
+#define STAGE_STATS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "psapi.lib")
+#endif
+#else
+#include <sys/resource.h>
+#endif
+
+#include "token_table.h"
+
+// Peak resident memory of the process in bytes
+inline uint64_t peakResidentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return (uint64_t)counters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return (uint64_t)usage.ru_maxrss; // Bytes on macOS
+#else
+    return (uint64_t)usage.ru_maxrss * 1024; // Kilobytes on Linux
+#endif
+#endif
+}
+
+class RunStats {
+public:
+    bool enabled = false;
+
+    void addStage(const char *name, double seconds) {
+        std::lock_guard<std::mutex> guard(lock);
+        entry(stageSeconds, name) += seconds;
+    }
+
+    void add(const char *name, double value) {
+        if (!enabled) {
+            return;
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        entry(counters, name) += value;
+    }
+
+    // Raises counter `name` to `value` if it is lower (for ratios, which do not add up)
+    void raise(const char *name, double value) {
+        if (!enabled) {
+            return;
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        double &counter = entry(counters, name);
+        counter = std::max(counter, value);
+    }
+
+    // Records the size and health of an intern table (the probe length walks the whole table)
+    // Sizes add up over several tables; the load factor and probe length keep the worst table
+    void recordTable(const TokenTable &table) {
+        if (!enabled) {
+            return;
+        }
+        add("distinct_tokens", (double)table.size());
+        add("hash_capacity", (double)table.tokenIds.capacity());
+        size_t capacity = table.tokenIds.capacity();
+        raise("hash_load_factor", capacity == 0 ? 0.0 : (double)table.tokenIds.size() / (double)capacity);
+        raise("hash_average_probe_length", table.tokenIds.averageProbeLength(table.idTokens));
+        add("hash_memory_bytes", (double)table.tokenIds.memoryBytes());
+        add("arena_bytes_used", (double)table.arena.bytesUsed());
+        add("arena_bytes_reserved", (double)table.arena.bytesReserved());
+    }
+
+    // Writes the statistics as one JSON object
+    void writeJson(const char *program, FILE *file = stderr) {
+        std::lock_guard<std::mutex> guard(lock);
+        fprintf(file, "{\"program\":\"%s\",\"stages\":{", program);
+        double total = 0.0;
+        for (size_t i = 0; i < stageSeconds.size(); ++i) {
+            fprintf(file, "%s\"%s\":%.6f", i > 0 ? "," : "", stageSeconds[i].first.c_str(), stageSeconds[i].second);
+            total += stageSeconds[i].second;
+        }
+        fprintf(file, "},\"total_seconds\":%.6f,\"counters\":{", total);
+        for (size_t i = 0; i < counters.size(); ++i) {
+            fprintf(file, "%s\"%s\":%.17g", i > 0 ? "," : "", counters[i].first.c_str(), counters[i].second);
+        }
+        fprintf(file, "},\"peak_rss_bytes\":%llu}\n", (unsigned long long)peakResidentBytes());
+    }
+
+private:
+    static double &entry(std::vector<std::pair<std::string, double>> &list, const char *name) {
+        for (auto &item : list) {
+            if (item.first == name) {
+                return item.second;
+            }
+        }
+        list.push_back({name, 0.0});
+        return list.back().second;
+    }
+
+    std::mutex lock;
+    std::vector<std::pair<std::string, double>> stageSeconds;
+    std::vector<std::pair<std::string, double>> counters;
+};
+
+// The process-wide statistics
+inline RunStats &runStats() {
+    static RunStats stats;
+    return stats;
+}
+
+// Adds the lifetime of the object to a stage (reads no clock while statistics are off)
+class ScopedStageTimer {
+public:
+    explicit ScopedStageTimer(const char *name) : name(name), active(runStats().enabled) {
+        if (active) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ScopedStageTimer() {
+        if (active) {
+            runStats().addStage(name, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+    }
+
+private:
+    const char *name;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Writes the JSON report when it goes out of scope, if --stats turned statistics on
+class StatsReport {
+public:
+    explicit StatsReport(const char *program) : program(program) {}
+    ~StatsReport() {
+        if (runStats().enabled) {
+            runStats().writeJson(program);
+        }
+    }
+
+private:
+    const char *program;
+};
+
+#define STATS_CONCATENATE_INNER(a, b) a##b
+#define STATS_CONCATENATE(a, b) STATS_CONCATENATE_INNER(a, b)
+
+#ifndef P5_NO_STATS
+#define STATS_TIMER(name) ScopedStageTimer STATS_CONCATENATE(stageTimer, __LINE__)(name)
+#define STATS_ADD(name, value) runStats().add(name, (double)(value))
+#define STATS_TABLE(table) runStats().recordTable(table)
+#else
+#define STATS_TIMER(name) ((void)0)
+#define STATS_ADD(name, value) ((void)0)
+#define STATS_TABLE(table) ((void)0)
+#endif
+
+#endif // STAGE_STATS_H
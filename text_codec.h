@@ -0,0 +1,856 @@
+/*
+ * File Name: text_codec.h
+ *
+ * Description:
+ * In-process encoder and decoder for programs that embed the codec instead of running
+ * `project5` and `project5_decompress` (include it and build with -std=c++17 -pthread).
+ *
+ * The encoder pipeline lives here, and `project5` is built on it: EncoderWorkspace counts a
+ * buffer (serially, in parallel chunks or with its separator runs) and remaps the ids in place,
+ * rankTokens sorts the vocabulary (or only its top K), and EncodedOutput writes every output
+ * format. `project5` times those stages one by one; Encoder runs them for embedding programs.
+ *
+ * Encoder ranks tokens exactly like `project5`. Input is fed as string views: encode() tokenizes
+ * a whole buffer in place (the buffer must stay valid until reset()), and feed() accepts a
+ * stream chunk by chunk, copying only the first occurrence of each distinct token. finish()
+ * sorts the vocabulary and leaves dictionary() (tokens in sorted order) and positions() (one
+ * 1-based position per input token) as views into the encoder; write() outputs the result in
+ * any format of `project5`.
+ *
+ * Decoder turns positions, or a whole binary container (encoded_format.h), back into text.
+ * Plain position runs go through the block decoder of decode_kernel.h.
+ *
+ * keepSeparators() makes encode() also record the whitespace between tokens
+ * (separator_stream.h), and decodeLossless() and lossless containers restore it exactly.
+ * Output is appended to a caller-owned string so its capacity is reused across calls.
+ *
+ * Both objects keep their tables and buffers across reset(), so a long-running caller reuses
+ * the same allocations for every request.
+ *
+ * Every function in this header and the headers it includes is inline, so any number of
+ * translation units can include it; text_codec_test.cpp links two of them to check that.
+ */
+
+#ifndef TEXT_CODEC_H
+#define TEXT_CODEC_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "decode_kernel.h"
+#include "dictionary_file.h"
+#include "encoded_format.h"
+#include "entropy_coder.h"
+#include "narrow_ids.h"
+#include "output_writer.h"
+#include "parallel_count.h"
+#include "separator_stream.h"
+#include "token_scanner.h"
+#include "token_table.h"
+
+// Number of narrow positions widened to ints per writePositions call
+const size_t POSITION_BLOCK_SIZE = 4096;
+
+// Layout of the encoded output
+enum class OutputFormat {
+    Text,   // Dictionary line, separator line, decimal positions
+    RawIds, // Dictionary line, separator line, 4-byte little-endian positions
+    Binary  // Binary container with a varint dictionary block and varint positions
+};
+
+// Options that control how the encoded output is written
+struct OutputOptions {
+    OutputFormat format = OutputFormat::Text;
+    bool framed = false;                    // Binary only: split positions into indexed frames
+    uint64_t frameSize = DEFAULT_FRAME_SIZE; // Tokens per frame
+    bool huffman = false;                   // Binary only: Huffman code the positions
+    FILE *destination = stdout;             // Where the encoded output is written
+    size_t topK = 0;                        // Rank only the K most frequent tokens (0 ranks all)
+    bool lossless = false;                  // Binary only: keep the whitespace between tokens
+    bool storeCounts = false;               // Binary only: write the count table for queries
+    bool backgroundWrites = true;           // Write full output buffers on a writer thread
+    TokenDelimiters delimiters = TokenDelimiters::Whitespace; // Bytes that separate tokens
+};
+
+// Helper function to rank the vocabulary and build the provisional-id-to-position remap
+// With a top-K limit only the K most frequent tokens get positions; every other id maps to an
+// escape value -(id + 1), which the output stage writes as an escape followed by the token
+// The full sort runs its frequency buckets on `threadCount` threads
+inline std::vector<int> rankTokens(const TokenTable &table, size_t topK, size_t threadCount,
+                                   std::vector<int> &idPosition) {
+    if (topK == 0) {
+        std::vector<int> sortedIds = sortTokenIds(table, threadCount);
+        idPosition = buildPositionMap(sortedIds);
+        return sortedIds;
+    }
+    std::vector<int> sortedIds = sortTopTokenIds(table, topK);
+    idPosition = buildPositionMap(sortedIds, table.size());
+    for (size_t id = 0; id < idPosition.size(); ++id) {
+        if (idPosition[id] == 0) {
+            idPosition[id] = -(int)id - 1; // Long tail token
+        }
+    }
+    return sortedIds;
+}
+
+// Output stage of the encoder
+// Writes the dictionary and then the positions in the selected format through one buffered writer
+class EncodedOutput {
+public:
+    explicit EncodedOutput(const OutputOptions &options)
+        : options(options), writer(options.destination), frameIndex(options.frameSize), bitWriter(writer) {
+        if (options.format != OutputFormat::Text) {
+            writer.setBinary();
+        }
+        if (options.backgroundWrites) {
+            writer.startBackgroundWrites(); // Positions are formatted while the last buffer is written
+        }
+    }
+
+    // Outputs the unique tokens in sorted order
+    // Text formats print the sorted tokens as a single space-separated line followed by the
+    // separator line; the binary format writes the container header and dictionary block
+    void writeDictionary(const TokenTable &table, const std::vector<int> &sortedIds, size_t idCount) {
+        if (options.format == OutputFormat::Binary) {
+            std::vector<std::string_view> dictionary;
+            dictionary.reserve(sortedIds.size());
+            for (int id : sortedIds) {
+                dictionary.push_back(table.token(id));
+            }
+            uint8_t flags = (options.framed ? CONTAINER_FLAG_FRAMED : 0) | (options.huffman ? CONTAINER_FLAG_HUFFMAN : 0) |
+                            (options.topK > 0 ? CONTAINER_FLAG_ESCAPES : 0) |
+                            (separators != nullptr ? CONTAINER_FLAG_SEPARATORS : 0) |
+                            (options.storeCounts ? CONTAINER_FLAG_COUNTS : 0);
+            writeContainerHeader(writer, dictionary, idCount, flags);
+            std::vector<uint64_t> counts; // Position p has the p-th highest count
+            if (options.huffman || options.storeCounts) {
+                counts.reserve(sortedIds.size());
+                for (int id : sortedIds) {
+                    counts.push_back((uint64_t)table.idFrequency[id]);
+                }
+            }
+            if (options.huffman) {
+                // The token frequencies are the model
+                huffman.build(counts);
+                writeCodeTable(writer, huffman.canonical.lengthCounts);
+            }
+            if (separators != nullptr) {
+                separators->writeBlock(writer);
+            }
+            if (options.storeCounts) {
+                writeCountTable(writer, counts);
+            }
+            return;
+        }
+        for (int id : sortedIds) {
+            writer.write(table.token(id));
+            writer.put(' ');
+        }
+        writer.write("\n**********\n");
+    }
+
+    // Outputs a reference to a saved dictionary instead of the tokens
+    // Both layouts record the dictionary file's token count and fingerprint so the decoder can
+    // check it was given the same file: text formats leave the dictionary line empty and append
+    // them to the separator line ("********** count fingerprint"); the binary format writes an
+    // empty dictionary block followed by them
+    void writeExternalDictionary(const DictionaryFile &dictionary, size_t idCount) {
+        if (options.format == OutputFormat::Binary) {
+            uint8_t flags = CONTAINER_FLAG_EXTERNAL_DICTIONARY | CONTAINER_FLAG_ESCAPES |
+                            (options.framed ? CONTAINER_FLAG_FRAMED : 0);
+            writeContainerHeader(writer, std::vector<std::string_view>(), idCount, flags);
+            writeExternalDictionaryReference(writer, dictionary.size(), dictionary.fingerprint());
+            return;
+        }
+        writer.write("\n********** ");
+        writer.writeNumber(dictionary.size(), ' ');
+        writer.writeNumber(dictionary.fingerprint(), '\n');
+    }
+
+    // Starts the online position stream: an empty dictionary line and the separator line
+    void writeOnlineHeader() { writer.write("\n**********\n"); }
+
+    // Marks the point where the online ranking is rebuilt
+    void writeRebuildMarker() { writer.write("- "); }
+
+    // Hands everything written so far to the output file
+    bool flush() { return writer.flush(); }
+
+    // Sets the table of tokens written as literals
+    // A negative value -(k + 1) passed to writePositions stands for literal k
+    void setLiterals(const TokenTable &table) { literals = &table; }
+
+    // Sets the separator runs written after the dictionary (--lossless)
+    void setSeparators(const SeparatorRecorder &recorder) { separators = &recorder; }
+
+    // Outputs a block of encoded positions
+    // Text output prints each position followed by a space, raw output writes 4 bytes per
+    // position and the binary format writes one varint per position
+    void writePositions(const int *positions, size_t count) {
+        switch (options.format) {
+        case OutputFormat::Text:
+            for (size_t i = 0; i < count; ++i) {
+                if (positions[i] < 0) { // Escape: 0 and then the token itself
+                    writer.write("0 ");
+                    writer.write(literal(positions[i]));
+                    writer.put(' ');
+                    continue;
+                }
+                writer.writeNumber((uint32_t)positions[i], ' ');
+            }
+            break;
+        case OutputFormat::RawIds:
+            for (size_t i = 0; i < count; ++i) {
+                if (positions[i] < 0) { // Escape: 0, the token length and the token bytes
+                    std::string_view token = literal(positions[i]);
+                    writer.writeUint32(0);
+                    writer.writeUint32((uint32_t)token.size());
+                    writer.write(token);
+                    continue;
+                }
+                writer.writeUint32((uint32_t)positions[i]);
+            }
+            break;
+        case OutputFormat::Binary:
+            for (size_t i = 0; i < count; ++i) {
+                if (options.framed) {
+                    if (options.huffman && frameIndex.startsNewFrame()) {
+                        bitWriter.alignToByte(); // Frames start on a byte boundary
+                    }
+                    frameIndex.beforePosition(writer);
+                }
+                if (options.huffman) {
+                    bitWriter.write(huffman.codes[positions[i] - 1], huffman.lengths[positions[i] - 1]);
+                } else if (positions[i] < 0) { // Escape: 0, the token length and the token bytes
+                    std::string_view token = literal(positions[i]);
+                    writer.writeVarint(0);
+                    writer.writeVarint(token.size());
+                    writer.write(token);
+                } else {
+                    writer.writeVarint((uint32_t)positions[i]);
+                }
+            }
+            break;
+        }
+    }
+
+    // Outputs positions stored at a narrow width, widened to ints a block at a time
+    void writePositions(const NarrowIdArray &positions) {
+        int block[POSITION_BLOCK_SIZE];
+        for (size_t first = 0; first < positions.size(); first += POSITION_BLOCK_SIZE) {
+            size_t count = std::min(POSITION_BLOCK_SIZE, positions.size() - first);
+            positions.read(first, count, block);
+            writePositions(block, count);
+        }
+    }
+
+    // Finishes the encoded output; false on a write error
+    bool finish() {
+        if (options.format == OutputFormat::Text) {
+            writer.put('\n');
+        } else if (options.format == OutputFormat::Binary) {
+            bitWriter.alignToByte();
+            if (options.framed) {
+                frameIndex.writeIndex(writer);
+            }
+        }
+        return writer.flush();
+    }
+
+private:
+    std::string_view literal(int value) const { return literals->token(-value - 1); }
+
+    const OutputOptions &options;
+    const TokenTable *literals = nullptr;
+    const SeparatorRecorder *separators = nullptr;
+    OutputWriter writer; // Buffers the whole output stage and flushes it in large blocks
+    FrameIndexWriter frameIndex;
+    HuffmanEncoder huffman;
+    BitWriter bitWriter;
+};
+
+// Tables and buffers of one encoder run, and the stages that fill them
+// Batch mode keeps one per worker and clears it between files, so the hash table, the token
+// arena and the vectors keep their capacity instead of being reallocated for every file
+struct EncoderWorkspace {
+    TokenTable table;                    // Intern table with per-token frequencies
+    NarrowIdArray tokenIds;              // Provisional id of every token occurrence, then its position
+    std::vector<ChunkCount> chunkCounts; // Per-thread tables and id sequences in parallel mode
+    TokenTable literals;                 // --dict-in: tokens missing from the dictionary
+    SeparatorRecorder separators;        // --lossless: whitespace runs between tokens
+
+    // Tokenizes the buffer once, interning each token and recording its provisional id
+    // Tokens are views into the buffer, so no token strings are allocated while counting. With
+    // threadCount > 1 each delimiter-aligned chunk is counted into a thread-local table and the
+    // tables are merged; `lossless` records the separator runs in the same pass, on one thread
+    void count(std::string_view input, size_t threadCount, TokenDelimiters delimiters, bool lossless) {
+        if (threadCount > 1 && !lossless) {
+            countChunksParallel(input, splitInput(input, threadCount, delimiters), chunkCounts, delimiters);
+            mergeChunkCounts(chunkCounts, table);
+        } else if (lossless) {
+            separators.start(input.data());
+            forEachToken(delimiters, input.data(), input.size(), [this](std::string_view token) {
+                tokenIds.push(table.intern(token));
+                separators.record(token);
+            });
+            separators.finish(input.data() + input.size());
+        } else {
+            forEachToken(delimiters, input.data(), input.size(),
+                         [this](std::string_view token) { tokenIds.push(table.intern(token)); });
+        }
+    }
+
+    // Number of tokens counted
+    size_t idCount() const {
+        size_t count = tokenIds.size();
+        for (const ChunkCount &chunk : chunkCounts) {
+            count += chunk.tokenIds.size();
+        }
+        return count;
+    }
+
+    // Turns the provisional ids into positions in place (rankTokens gives the map)
+    // The positions keep the narrow width of the ids; parallel chunks are remapped by their threads
+    void remap(const std::vector<int> &idPosition) {
+        if (!chunkCounts.empty()) {
+            remapChunksParallel(chunkCounts, idPosition);
+        } else {
+            tokenIds.remap(idPosition);
+        }
+    }
+
+    // Memory of the id arrays (for --stats)
+    size_t positionBytes() const {
+        size_t bytes = tokenIds.memoryBytes();
+        for (const ChunkCount &chunk : chunkCounts) {
+            bytes += chunk.tokenIds.memoryBytes();
+        }
+        return bytes;
+    }
+
+    // Outputs the positions after remap(), parallel chunks in input order
+    void writePositions(EncodedOutput &output) const {
+        output.writePositions(tokenIds);
+        for (const ChunkCount &chunk : chunkCounts) {
+            output.writePositions(chunk.tokenIds);
+        }
+    }
+
+    void clear() {
+        table.clear();
+        tokenIds.clear();
+        chunkCounts.clear();
+        literals.clear();
+        separators.clear();
+    }
+};
+
+// Token ranking and position encoding
+// Runs the stages `project5` runs on a buffer (EncoderWorkspace, rankTokens, EncodedOutput) on
+// one thread, so both produce the same dictionary, positions and output bytes
+class Encoder {
+public:
+    // Makes encode() record the separator runs between tokens too (lossless mode)
+    // Lossless input is one encode() call; feed() never records separators
+    void keepSeparators(bool keep = true) { keepingSeparators = keep; }
+
+    // Tokenizes a complete buffer without copying its tokens
+    // The buffer must stay valid until reset()
+    void encode(std::string_view buffer) {
+        flushCarry();
+        workspace.count(buffer, 1, TokenDelimiters::Whitespace, keepingSeparators);
+    }
+
+    // Tokenizes the next chunk of a stream; a token may continue into the next chunk
+    // The chunk can be reused as soon as feed() returns
+    void feed(std::string_view chunk) {
+        tokenizer.feed(chunk.data(), chunk.size(), [this](std::string_view token) {
+            workspace.tokenIds.push(workspace.table.internCopy(token));
+        });
+    }
+
+    // Sorts the vocabulary and turns the recorded ids into positions
+    // With topK > 0 only the K most frequent tokens are ranked (`project5 --top-k`); every
+    // other token gets the escape value -(id + 1), where table().token(id) is the token
+    void finish(size_t topK = 0) {
+        flushCarry();
+        rankLimit = topK;
+        sortedIds = rankTokens(workspace.table, topK, 1, idPosition);
+        sortedTokens.clear();
+        sortedCounts.clear();
+        for (int id : sortedIds) {
+            sortedTokens.push_back(workspace.table.token(id));
+            sortedCounts.push_back((uint64_t)workspace.table.idFrequency[id]);
+        }
+        workspace.remap(idPosition); // In place: provisional ids become positions
+        positionList.resize(workspace.tokenIds.size());
+        workspace.tokenIds.read(0, positionList.size(), positionList.data());
+    }
+
+    // Tokens in sorted order (position p is dictionary()[p - 1]); valid after finish()
+    const std::vector<std::string_view> &dictionary() const { return sortedTokens; }
+
+    // Frequency of each token in dictionary(); valid after finish()
+    const std::vector<uint64_t> &counts() const { return sortedCounts; }
+
+    // Position of every input token, in input order; valid after finish()
+    const std::vector<int> &positions() const { return positionList; }
+
+    // Intern table of the input (provisional ids, frequencies, token arena)
+    const TokenTable &table() const { return workspace.table; }
+
+    // Separator runs recorded by a lossless encode()
+    const SeparatorRecorder &separators() const { return workspace.separators; }
+
+    // Writes the result to options.destination in any output format of `project5` (text, raw
+    // ids, or a binary container that is framed, Huffman-coded or stores counts); the ranking
+    // is the one chosen by finish(), and a lossless result writes its separator block
+    // Returns false on a write error
+    bool write(OutputOptions options) const {
+        options.topK = rankLimit;
+        options.lossless = keepingSeparators;
+        EncodedOutput output(options);
+        output.setLiterals(workspace.table); // Long tail tokens of a top-K ranking
+        if (keepingSeparators) {
+            output.setSeparators(workspace.separators);
+        }
+        output.writeDictionary(workspace.table, sortedIds, workspace.idCount());
+        workspace.writePositions(output);
+        return output.finish();
+    }
+
+    // Forgets the previous input but keeps every allocation for the next one
+    void reset() {
+        workspace.clear();
+        tokenizer = StreamTokenizer();
+        sortedIds.clear();
+        idPosition.clear();
+        sortedTokens.clear();
+        sortedCounts.clear();
+        positionList.clear();
+        rankLimit = 0;
+    }
+
+private:
+    // Passes a token left over from feed() before anything else is recorded
+    void flushCarry() {
+        tokenizer.finish([this](std::string_view token) {
+            workspace.tokenIds.push(workspace.table.internCopy(token));
+        });
+    }
+
+    EncoderWorkspace workspace;
+    StreamTokenizer tokenizer;
+    std::vector<int> sortedIds;
+    std::vector<int> idPosition;
+    std::vector<std::string_view> sortedTokens;
+    std::vector<uint64_t> sortedCounts;
+    std::vector<int> positionList; // The remapped ids widened to ints, for positions()
+    size_t rankLimit = 0;
+    bool keepingSeparators = false;
+};
+
+// Position sources
+// next() reads one position; an escape is returned as position 0 with the token in `literal`
+
+// Position source for varint-coded containers
+class VarintPositions {
+public:
+    VarintPositions(std::string_view container, size_t start, size_t end, bool escapes)
+        : reader(container.substr(0, end), start), escapes(escapes) {}
+
+    bool next(uint64_t &position, std::string_view &literal) {
+        if (!reader.readVarint(position)) {
+            return false;
+        }
+        uint64_t length;
+        return position != 0 || !escapes || (reader.readVarint(length) && reader.readBytes(length, literal));
+    }
+
+private:
+    ByteReader reader;
+    bool escapes;
+};
+
+// Position source for Huffman-coded containers
+class HuffmanPositions {
+public:
+    HuffmanPositions(const HuffmanDecoder &decoder, std::string_view container, size_t start, size_t end)
+        : decoder(decoder), reader(container.substr(start, end - start)) {}
+
+    bool next(uint64_t &position, std::string_view &) {
+        long long symbol = decoder.decode(reader);
+        if (symbol < 0 || reader.overrun()) {
+            return false;
+        }
+        position = (uint64_t)symbol + 1;
+        return true;
+    }
+
+private:
+    const HuffmanDecoder &decoder;
+    BitReader reader;
+};
+
+// Decodes a run of positions
+// Reads `skip + take` positions from the source and appends the last `take` tokens to `text`
+// separated by single spaces
+template <typename PositionSource>
+bool decodePositions(PositionSource &source, const TokenBlob &tokens, uint64_t skip, uint64_t take,
+                     std::string &text, std::string &errorMessage) {
+    for (uint64_t t = 0; t < skip + take; ++t) {
+        uint64_t position;
+        std::string_view literal;
+        if (!source.next(position, literal)) {
+            errorMessage = "Truncated or corrupt position stream.";
+            return false;
+        }
+        if ((position == 0 && literal.empty()) || position > tokens.size()) {
+            errorMessage = "Invalid position " + std::to_string(position);
+            return false;
+        }
+        if (t >= skip) {
+            if (t > skip) {
+                text += ' ';
+            }
+            text.append(position == 0 ? literal : tokens.token(position - 1));
+        }
+    }
+    return true;
+}
+
+// Decodes a run of positions of a lossless container, interleaved with the separator runs
+// `separators` must be at gap `skip`. The gap before the first token is written only when
+// skip is 0, and the gap after the last token only when `last` says the run ends the input.
+template <typename PositionSource>
+bool decodeLosslessPositions(PositionSource &source, const TokenBlob &tokens, SeparatorReader &separators,
+                             uint64_t skip, uint64_t take, bool last, std::string &text,
+                             std::string &errorMessage) {
+    for (uint64_t t = 0; t < skip + take; ++t) {
+        uint64_t position;
+        std::string_view literal;
+        std::string_view separator;
+        if (!source.next(position, literal)) {
+            errorMessage = "Truncated or corrupt position stream.";
+            return false;
+        }
+        if ((position == 0 && literal.empty()) || position > tokens.size()) {
+            errorMessage = "Invalid position " + std::to_string(position);
+            return false;
+        }
+        if (!separators.next(separator)) {
+            errorMessage = "Truncated or corrupt separator stream.";
+            return false;
+        }
+        if (t > skip || (t == skip && skip == 0)) {
+            text.append(separator);
+        }
+        if (t >= skip) {
+            text.append(position == 0 ? literal : tokens.token(position - 1));
+        }
+    }
+    std::string_view separator;
+    if (last && (take > 0 || skip == 0)) {
+        if (!separators.next(separator)) {
+            errorMessage = "Truncated or corrupt separator stream.";
+            return false;
+        }
+        text.append(separator);
+    }
+    return true;
+}
+
+// Block decoder for the plain varint positions of a lossless container
+// Same output as decodeLosslessPositions, but positions are unpacked and checked a block at a
+// time and the token bytes are bulk-copied (decode_kernel.h); `offset` is left after the last
+// position read
+inline bool decodeLosslessVarintBlocks(std::string_view container, size_t &offset, size_t end,
+                                       const TokenBlob &tokens, SeparatorReader &separators, uint64_t skip,
+                                       uint64_t take, bool last, std::string &text, std::string &errorMessage) {
+    const uint8_t *data = (const uint8_t *)container.data();
+    size_t used = text.size();
+    uint64_t values[DECODE_BLOCK_SIZE];
+    std::string_view gaps[DECODE_BLOCK_SIZE];
+    for (uint64_t done = 0; done < skip + take;) {
+        size_t count = (size_t)std::min<uint64_t>(DECODE_BLOCK_SIZE, skip + take - done);
+        size_t unpacked = unpackVarints(data, end, offset, values, count);
+        size_t invalid = tokens.findInvalid(values, unpacked);
+        if (invalid < unpacked || unpacked < count) {
+            text.resize(used);
+            errorMessage = invalid < unpacked ? "Invalid position " + std::to_string(values[invalid])
+                                              : "Truncated or corrupt position stream.";
+            return false;
+        }
+        size_t needed = TOKEN_COPY_SLACK;
+        for (size_t i = 0; i < count; ++i) {
+            if (!separators.next(gaps[i])) {
+                text.resize(used);
+                errorMessage = "Truncated or corrupt separator stream.";
+                return false;
+            }
+            needed += gaps[i].size() + tokens.entrySize(values[i]);
+        }
+        growOutput(text, used + needed);
+        char *output = &text[0];
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t t = done + i;
+            if (t > skip || (t == skip && skip == 0)) {
+                if (gaps[i].size() == 1) {
+                    output[used++] = gaps[i][0];
+                } else {
+                    memcpy(output + used, gaps[i].data(), gaps[i].size());
+                    used += gaps[i].size();
+                }
+            }
+            if (t >= skip) {
+                tokens.copyToken(values[i], output, used);
+            }
+        }
+        done += count;
+    }
+    text.resize(used);
+    std::string_view separator;
+    if (last && (take > 0 || skip == 0)) {
+        if (!separators.next(separator)) {
+            errorMessage = "Truncated or corrupt separator stream.";
+            return false;
+        }
+        text.append(separator);
+    }
+    return true;
+}
+
+inline bool decodeLosslessVarintRun(std::string_view container, size_t start, size_t end, const TokenBlob &tokens,
+                                    SeparatorReader &separators, uint64_t skip, uint64_t take, bool last,
+                                    std::string &text, std::string &errorMessage) {
+    return decodeLosslessVarintBlocks(container, start, end, tokens, separators, skip, take, last, text,
+                                      errorMessage);
+}
+
+// Decodes positions [skip, skip + take) of a lossless container with their separator runs
+inline bool decodeLosslessRange(const ContainerHeader &header, const TokenBlob &tokens, const HuffmanDecoder &huffman,
+                                std::string_view container, size_t start, size_t end, uint64_t skip, uint64_t take,
+                                std::string &text, std::string &errorMessage) {
+    if (header.flags & CONTAINER_FLAG_FRAMED) {
+        errorMessage = "Framed lossless containers are not supported.";
+        return false;
+    }
+    SeparatorReader separators;
+    if (!separators.open(header.separatorBlock, errorMessage)) {
+        return false;
+    }
+    bool last = skip + take == header.idCount;
+    if (header.flags & CONTAINER_FLAG_HUFFMAN) {
+        HuffmanPositions source(huffman, container, start, end);
+        return decodeLosslessPositions(source, tokens, separators, skip, take, last, text, errorMessage);
+    }
+    if (header.flags & CONTAINER_FLAG_ESCAPES) {
+        VarintPositions source(container, start, end, true);
+        return decodeLosslessPositions(source, tokens, separators, skip, take, last, text, errorMessage);
+    }
+    return decodeLosslessVarintRun(container, start, end, tokens, separators, skip, take, last, text, errorMessage);
+}
+
+// Decodes a byte range of a container with the right position source
+// Plain varint positions go through the block decoder (decode_kernel.h)
+inline bool decodeRange(const ContainerHeader &header, const TokenBlob &tokens, const HuffmanDecoder &huffman,
+                        std::string_view container, size_t start, size_t end, uint64_t skip, uint64_t take,
+                        std::string &text, std::string &errorMessage) {
+    if (header.flags & CONTAINER_FLAG_HUFFMAN) {
+        HuffmanPositions source(huffman, container, start, end);
+        return decodePositions(source, tokens, skip, take, text, errorMessage);
+    }
+    if (header.flags & CONTAINER_FLAG_ESCAPES) {
+        VarintPositions source(container, start, end, true);
+        return decodePositions(source, tokens, skip, take, text, errorMessage);
+    }
+    return decodeVarintRun(container, start, end, tokens, skip, take, text, errorMessage);
+}
+
+// Decodes positions [skip, skip + take) of an unframed container one block at a time
+// Every next() call appends the text of up to DECODE_BLOCK_SIZE more tokens, so a caller can
+// write each block out before decoding the next and never holds the whole text. Lossless blocks
+// carry their separator runs; plain blocks separate their tokens with single spaces and the
+// caller puts one between non-empty blocks.
+class ContainerRangeDecoder {
+public:
+    ContainerRangeDecoder(const ContainerHeader &header, const TokenBlob &tokens, const HuffmanDecoder &huffman,
+                          std::string_view container, size_t start, size_t end, uint64_t skip, uint64_t take)
+        : header(header), tokens(tokens), container(container), offset(start), end(end), skip(skip), left(take),
+          endsInput(skip + take == header.idCount), huffmanSource(huffman, container, start, end),
+          varintSource(container, start, end, true) {}
+
+    // True once every position of the range has been decoded
+    bool finished() const { return started && left == 0; }
+
+    // Appends the text of the next block to `text`
+    // The first block also reads the `skip` positions before the range
+    bool next(std::string &text, std::string &errorMessage) {
+        bool lossless = (header.flags & CONTAINER_FLAG_SEPARATORS) != 0;
+        if (!started) {
+            started = true;
+            if (lossless && (header.flags & CONTAINER_FLAG_FRAMED)) {
+                errorMessage = "Framed lossless containers are not supported.";
+                return false;
+            }
+            if (lossless && !separators.open(header.separatorBlock, errorMessage)) {
+                return false;
+            }
+        }
+        uint64_t blockSkip = skip;
+        uint64_t blockTake = std::min<uint64_t>(DECODE_BLOCK_SIZE, left);
+        skip = 0;
+        left -= blockTake;
+        if (lossless) { // Later blocks start with the gap before their first token
+            bool last = left == 0 && endsInput;
+            if (header.flags & CONTAINER_FLAG_HUFFMAN) {
+                return decodeLosslessPositions(huffmanSource, tokens, separators, blockSkip, blockTake, last, text,
+                                               errorMessage);
+            }
+            if (header.flags & CONTAINER_FLAG_ESCAPES) {
+                return decodeLosslessPositions(varintSource, tokens, separators, blockSkip, blockTake, last, text,
+                                               errorMessage);
+            }
+            return decodeLosslessVarintBlocks(container, offset, end, tokens, separators, blockSkip, blockTake, last,
+                                              text, errorMessage);
+        }
+        if (header.flags & CONTAINER_FLAG_HUFFMAN) {
+            return decodePositions(huffmanSource, tokens, blockSkip, blockTake, text, errorMessage);
+        }
+        if (header.flags & CONTAINER_FLAG_ESCAPES) {
+            return decodePositions(varintSource, tokens, blockSkip, blockTake, text, errorMessage);
+        }
+        return decodeVarintBlocks(container, offset, end, tokens, blockSkip, blockTake, text, errorMessage);
+    }
+
+private:
+    const ContainerHeader &header;
+    const TokenBlob &tokens;
+    std::string_view container;
+    size_t offset; // Next plain varint position
+    size_t end;
+    uint64_t skip;
+    uint64_t left; // Positions of the range not decoded yet
+    bool endsInput;
+    bool started = false;
+    HuffmanPositions huffmanSource;
+    VarintPositions varintSource;
+    SeparatorReader separators;
+};
+
+// Picks the rank -> token table for a container: its own dictionary block, or the saved
+// dictionary it was encoded against (checked against the recorded fingerprint)
+inline bool selectContainerTokens(const ContainerHeader &header, const DictionaryFile *dictionary,
+                                  std::vector<std::string_view> &savedTokens,
+                                  const std::vector<std::string_view> *&tokens, std::string &errorMessage) {
+    tokens = &header.dictionary;
+    if ((header.flags & CONTAINER_FLAG_EXTERNAL_DICTIONARY) == 0) {
+        return true;
+    }
+    if (dictionary == nullptr) {
+        errorMessage = "This input was encoded against a saved dictionary; pass it with --dict-in.";
+        return false;
+    }
+    if (dictionary->size() != header.externalTokenCount || dictionary->fingerprint() != header.externalFingerprint) {
+        errorMessage = "The --dict-in dictionary is not the one this input was encoded with.";
+        return false;
+    }
+    savedTokens = dictionary->tokens();
+    tokens = &savedTokens;
+    return true;
+}
+
+// Position decoding back to text
+class Decoder {
+public:
+    // Uses `tokens` (in sorted order) as the dictionary for decode(); the tokens are copied
+    void setDictionary(const std::vector<std::string_view> &tokens) { dictionaryBlob.assign(tokens); }
+
+    // Appends the tokens at `positions` to `text`, separated by single spaces
+    bool decode(const int *positions, size_t count, std::string &text, std::string &errorMessage) const {
+        return decodePositionArray(positions, count, dictionaryBlob, text, errorMessage);
+    }
+
+    // Appends the input of a lossless encode exactly: the tokens at `positions` with the
+    // separator runs between them (separators.gapCount() must be count + 1)
+    bool decodeLossless(const int *positions, size_t count, const SeparatorRecorder &separators, std::string &text,
+                        std::string &errorMessage) const {
+        size_t invalid = dictionaryBlob.findInvalid(positions, count);
+        if (invalid < count) {
+            errorMessage = "Invalid position " + std::to_string(positions[invalid]);
+            return false;
+        }
+        if (separators.gapCount() != count + 1) {
+            errorMessage = "Separator runs do not match the positions.";
+            return false;
+        }
+        const std::vector<OtherGap> &otherGaps = separators.otherGapList();
+        size_t next = 0; // Next entry of otherGaps
+        for (size_t i = 0; i <= count; ++i) {
+            if (next < otherGaps.size() && otherGaps[next].gap == i) {
+                text.append(separators.separator(otherGaps[next++].id));
+            } else {
+                text.append(separators.separator(0));
+            }
+            if (i < count) {
+                text.append(dictionaryBlob.token(positions[i] - 1));
+            }
+        }
+        return true;
+    }
+
+    // Appends the text of a whole binary container to `text`
+    // `dictionary` is the saved dictionary for containers written with `--dict-in`
+    bool decodeContainer(std::string_view container, std::string &text, std::string &errorMessage,
+                         const DictionaryFile *dictionary = nullptr) {
+        ByteReader reader(container);
+        const std::vector<std::string_view> *tokens;
+        if (!readContainerHeader(reader, header, errorMessage) ||
+            !selectContainerTokens(header, dictionary, savedTokens, tokens, errorMessage)) {
+            return false;
+        }
+        if ((header.flags & CONTAINER_FLAG_HUFFMAN) && !huffman.build(header.codeLengthCounts)) {
+            errorMessage = "Invalid Huffman code table.";
+            return false;
+        }
+        containerBlob.assign(*tokens);
+        if (header.flags & CONTAINER_FLAG_SEPARATORS) {
+            return decodeLosslessRange(header, containerBlob, huffman, container, reader.position(),
+                                       container.size(), 0, header.idCount, text, errorMessage);
+        }
+        if ((header.flags & CONTAINER_FLAG_FRAMED) == 0) {
+            return decodeRange(header, containerBlob, huffman, container, reader.position(), container.size(), 0,
+                               header.idCount, text, errorMessage);
+        }
+        size_t indexStart;
+        if (!readFrameIndex(container, reader.position(), frames, indexStart, errorMessage)) {
+            return false;
+        }
+        for (size_t f = 0; f < frames.size(); ++f) { // Huffman frames are byte aligned, so decode each on its own
+            size_t frameEnd = f + 1 < frames.size() ? (size_t)frames[f + 1].byteOffset : indexStart;
+            if (f > 0 && frames[f].tokenCount > 0) {
+                text += ' ';
+            }
+            if (!decodeRange(header, containerBlob, huffman, container, (size_t)frames[f].byteOffset, frameEnd, 0,
+                             frames[f].tokenCount, text, errorMessage)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    TokenBlob dictionaryBlob;
+    TokenBlob containerBlob;
+    ContainerHeader header;
+    HuffmanDecoder huffman;
+    std::vector<FrameEntry> frames;
+    std::vector<std::string_view> savedTokens;
+};
+
+#endif // TEXT_CODEC_H
@@ -0,0 +1,63 @@
+/*
+ * Program Name: Text Codec Library Test
+ *
+ * Description:
+ * This program checks that text_codec.h works as an embeddable header-only library. It is
+ * linked from two translation units that both include the header (this file and
+ * text_codec_test_unit.cpp), so a header function that is not inline fails the build with a
+ * multiple definition error. The program then encodes an input in one unit and decodes it in
+ * the other, plain and lossless, and compares the result with the input.
+ *
+ * Usage:
+ *   text_codec_test            Run the checks; prints OK or a line per failure
+ *
+ * Build: g++ -std=c++17 -O2 -pthread text_codec_test.cpp text_codec_test_unit.cpp -o text_codec_test
+ *        (add -lpsapi when building with MinGW on Windows)
+ */
+
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "text_codec.h"
+
+using namespace std;
+
+// Defined in text_codec_test_unit.cpp
+string encodeContainerInSecondUnit(string_view input, bool lossless);
+
+int main() {
+    const string input = "the quick brown fox\tjumps over\n\nthe lazy dog  the end\n";
+    const string expected = "the quick brown fox jumps over the lazy dog the end";
+    int failureCount = 0;
+
+    // Step 1: Encode and decode in this unit
+    Encoder encoder;
+    encoder.encode(input);
+    encoder.finish();
+    Decoder decoder;
+    decoder.setDictionary(encoder.dictionary());
+    string decoded, errorMessage;
+    if (!decoder.decode(encoder.positions().data(), encoder.positions().size(), decoded, errorMessage) ||
+        decoded != expected) {
+        cerr << "Error: Positions do not decode to the input tokens. " << errorMessage << endl;
+        ++failureCount;
+    }
+
+    // Step 2: Decode containers written by the other unit
+    for (bool lossless : {false, true}) {
+        string container = encodeContainerInSecondUnit(input, lossless);
+        decoded.clear();
+        if (!decoder.decodeContainer(container, decoded, errorMessage) || decoded != (lossless ? input : expected)) {
+            cerr << "Error: The " << (lossless ? "lossless " : "") << "container does not decode to the input. "
+                 << errorMessage << endl;
+            ++failureCount;
+        }
+    }
+
+    if (failureCount > 0) {
+        return 1;
+    }
+    cout << "OK" << endl;
+    return 0;
+}
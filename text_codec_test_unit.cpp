@@ -0,0 +1,39 @@
+/*
+ * File Name: text_codec_test_unit.cpp
+ *
+ * Description:
+ * Second translation unit of text_codec_test.cpp. It includes text_codec.h (and through it
+ * every header the library is built on) on its own, so linking it with text_codec_test.cpp
+ * fails if a header defines a function that is not inline.
+ */
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#include "text_codec.h"
+
+// Encodes the input into a binary container with the library encoder
+// Returns an empty string if the temporary file cannot be written
+std::string encodeContainerInSecondUnit(std::string_view input, bool lossless) {
+    Encoder encoder;
+    encoder.keepSeparators(lossless);
+    encoder.encode(input);
+    encoder.finish();
+    std::string container;
+    FILE *file = std::tmpfile();
+    if (file == nullptr) {
+        return container;
+    }
+    OutputOptions options;
+    options.format = OutputFormat::Binary;
+    options.destination = file;
+    if (encoder.write(options)) {
+        long size = std::ftell(file);
+        std::rewind(file);
+        container.resize(size > 0 ? (size_t)size : 0);
+        container.resize(std::fread(&container[0], 1, container.size(), file));
+    }
+    std::fclose(file);
+    return container;
+}
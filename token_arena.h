@@ -0,0 +1,80 @@
+/*
+ * File Name: token_arena.h
+ *
+ * Description:
+ * Bump-pointer arena for token bytes. Tokens are copied back to back into large blocks, so
+ * storing a distinct token costs no heap allocation of its own and no per-string header. A block
+ * is never reallocated once written, so the std::string_view handed out for a token stays valid
+ * until the arena is reset or destroyed and every structure (count table, sorted list, position
+ * map, decode table) can refer to the token through that one view.
+ */
+
+#ifndef TOKEN_ARENA_H
+#define TOKEN_ARENA_H
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+class TokenArena {
+public:
+    static constexpr size_t BLOCK_SIZE = 1 << 20;
+
+    TokenArena() = default;
+    TokenArena(const TokenArena &) = delete;
+    TokenArena &operator=(const TokenArena &) = delete;
+    TokenArena(TokenArena &&) = default;
+    TokenArena &operator=(TokenArena &&) = default;
+
+    // Copies the token into the arena and returns a view of the stored bytes
+    std::string_view store(std::string_view token) {
+        if (token.size() > remaining) {
+            addBlock(token.size());
+        }
+        char *destination = cursor;
+        memcpy(destination, token.data(), token.size());
+        cursor += token.size();
+        remaining -= token.size();
+        usedBytes += token.size();
+        return std::string_view(destination, token.size());
+    }
+
+    // Number of token bytes stored
+    size_t bytesUsed() const { return usedBytes; }
+
+    // Number of bytes reserved in blocks
+    size_t bytesReserved() const { return reservedBytes; }
+
+    // Forgets every stored token but keeps the first block for reuse
+    void reset() {
+        if (blocks.size() > 1) {
+            blocks.resize(1);
+            blockSizes.resize(1);
+        }
+        reservedBytes = blockSizes.empty() ? 0 : blockSizes[0];
+        cursor = blocks.empty() ? nullptr : blocks[0].get();
+        remaining = reservedBytes;
+        usedBytes = 0;
+    }
+
+private:
+    void addBlock(size_t minimumSize) {
+        size_t size = minimumSize > BLOCK_SIZE ? minimumSize : BLOCK_SIZE; // Huge tokens get their own block
+        blocks.emplace_back(new char[size]);
+        blockSizes.push_back(size);
+        cursor = blocks.back().get();
+        remaining = size;
+        reservedBytes += size;
+    }
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    std::vector<size_t> blockSizes;
+    char *cursor = nullptr;
+    size_t remaining = 0;
+    size_t usedBytes = 0;
+    size_t reservedBytes = 0;
+};
+
+#endif // TOKEN_ARENA_H
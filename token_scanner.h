@@ -0,0 +1,454 @@
+/*
+ * File Name: token_scanner.h
+ *
+ * Description:
+ * Tokenizers that split text on whitespace and hand each token to a callback as a
+ * std::string_view. The views point into the caller's buffer, so scanning allocates nothing.
+ * forEachToken scans one contiguous buffer; StreamTokenizer does the same over a sequence of
+ * chunks, carrying a token that is split across a chunk boundary.
+ *
+ * Token boundaries are found 64 bytes at a time. A vectorized kernel (AVX2 or SSE2 on x86-64,
+ * NEON on AArch64, a table lookup elsewhere) turns each block into a 64-bit whitespace mask,
+ * and the token starts and ends are read off the mask transitions. The kernel is picked once at
+ * runtime from what the CPU supports. Whitespace is exactly the set `isspace` reports in the C
+ * locale: space, \t, \n, \v, \f and \r.
+ *
+ * The delimiter set is a template policy. WhitespaceDelimiters is the default; CharacterDelimiters
+ * splits on a fixed list of characters (CsvDelimiters for comma-separated fields, PipeDelimiters
+ * for `|`-separated log fields). Every policy has a constexpr 256-entry lookup table for
+ * byte-at-a-time checks and its own mask kernel, whose compares are unrolled at compile time, so
+ * each delimiter set gets its own specialized loop. withDelimiters() picks the policy for a
+ * runtime TokenDelimiters value once per buffer or chunk, never per byte.
+ */
+
+#ifndef TOKEN_SCANNER_H
+#define TOKEN_SCANNER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define TOKEN_SCANNER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define TOKEN_SCANNER_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Number of bytes classified per whitespace mask
+const size_t SCAN_BLOCK_SIZE = 64;
+
+// Lookup table of the bytes that separate tokens
+struct DelimiterTable {
+    bool isDelimiter[256] = {};
+};
+
+// Builds the lookup table of a delimiter set at compile time
+template <char... Characters>
+constexpr DelimiterTable delimiterTableOf() {
+    DelimiterTable table;
+    ((table.isDelimiter[(unsigned char)Characters] = true), ...);
+    return table;
+}
+
+// The C locale whitespace characters
+inline constexpr DelimiterTable WHITESPACE_TABLE = delimiterTableOf<' ', '\t', '\n', '\v', '\f', '\r'>();
+
+// Returns true if the character is whitespace (separates tokens by default)
+inline bool isTokenSpace(char aChar) {
+    return WHITESPACE_TABLE.isDelimiter[(unsigned char)aChar];
+}
+
+// Whitespace mask kernels
+// Each returns a mask with bit i set when block[i] is whitespace, for a 64-byte block
+
+inline uint64_t whitespaceMaskScalar(const char *block) {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < SCAN_BLOCK_SIZE; ++i) {
+        mask |= (uint64_t)isTokenSpace(block[i]) << i;
+    }
+    return mask;
+}
+
+#ifdef TOKEN_SCANNER_X86
+inline uint64_t whitespaceMaskSse2(const char *block) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i controlSpan = _mm_set1_epi8('\r' - '\t');
+    uint64_t mask = 0;
+    for (int lane = 0; lane < 4; ++lane) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(block + lane * 16));
+        __m128i isSpace = _mm_cmpeq_epi8(bytes, space);
+        __m128i offset = _mm_sub_epi8(bytes, tab); // \t..\r become 0..4
+        __m128i isControl = _mm_cmpeq_epi8(_mm_min_epu8(offset, controlSpan), offset);
+        uint32_t laneMask = (uint32_t)_mm_movemask_epi8(_mm_or_si128(isSpace, isControl));
+        mask |= (uint64_t)laneMask << (lane * 16);
+    }
+    return mask;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((target("avx2")))
+#endif
+inline uint64_t whitespaceMaskAvx2(const char *block) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i controlSpan = _mm256_set1_epi8('\r' - '\t');
+    uint64_t mask = 0;
+    for (int lane = 0; lane < 2; ++lane) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i *)(block + lane * 32));
+        __m256i isSpace = _mm256_cmpeq_epi8(bytes, space);
+        __m256i offset = _mm256_sub_epi8(bytes, tab); // \t..\r become 0..4
+        __m256i isControl = _mm256_cmpeq_epi8(_mm256_min_epu8(offset, controlSpan), offset);
+        uint32_t laneMask = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(isSpace, isControl));
+        mask |= (uint64_t)laneMask << (lane * 32);
+    }
+    return mask;
+}
+
+// Returns true if the CPU and operating system support AVX2
+inline bool cpuSupportsAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int registers[4];
+    __cpuid(registers, 1);
+    bool osSavesYmm = (registers[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+    __cpuidex(registers, 7, 0);
+    return osSavesYmm && (registers[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif // TOKEN_SCANNER_X86
+
+#ifdef TOKEN_SCANNER_NEON
+inline uint64_t whitespaceMaskNeon(const char *block) {
+    static const uint8_t bitValues[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    const uint8x16_t bits = vld1q_u8(bitValues);
+    const uint8x16_t space = vdupq_n_u8(' ');
+    const uint8x16_t tab = vdupq_n_u8('\t');
+    const uint8x16_t controlSpan = vdupq_n_u8('\r' - '\t');
+    uint8x16_t laneBits[4];
+    for (int lane = 0; lane < 4; ++lane) {
+        uint8x16_t bytes = vld1q_u8((const uint8_t *)block + lane * 16);
+        uint8x16_t isSpace = vceqq_u8(bytes, space);
+        uint8x16_t isControl = vcleq_u8(vsubq_u8(bytes, tab), controlSpan); // \t..\r become 0..4
+        laneBits[lane] = vandq_u8(vorrq_u8(isSpace, isControl), bits);
+    }
+    // Pairwise adds fold the per-byte bits into eight mask bytes
+    uint8x16_t sum = vpaddq_u8(vpaddq_u8(laneBits[0], laneBits[1]), vpaddq_u8(laneBits[2], laneBits[3]));
+    sum = vpaddq_u8(sum, sum);
+    return vgetq_lane_u64(vreinterpretq_u64_u8(sum), 0);
+}
+#endif // TOKEN_SCANNER_NEON
+
+typedef uint64_t (*WhitespaceMaskFunction)(const char *block);
+typedef WhitespaceMaskFunction DelimiterMaskFunction; // Any delimiter set
+
+// Picks the fastest whitespace mask kernel for this CPU (done once per process)
+inline WhitespaceMaskFunction selectWhitespaceMask() {
+#if defined(TOKEN_SCANNER_X86)
+    static const WhitespaceMaskFunction selected = cpuSupportsAvx2() ? whitespaceMaskAvx2 : whitespaceMaskSse2;
+    return selected;
+#elif defined(TOKEN_SCANNER_NEON)
+    return whitespaceMaskNeon;
+#else
+    return whitespaceMaskScalar;
+#endif
+}
+
+// Delimiter mask kernels for a fixed list of characters
+// Each byte is compared with every delimiter; the fold unrolls the compares at compile time
+
+template <typename Delimiters>
+inline uint64_t delimiterMaskScalar(const char *block) {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < SCAN_BLOCK_SIZE; ++i) {
+        mask |= (uint64_t)Delimiters::isDelimiter(block[i]) << i;
+    }
+    return mask;
+}
+
+#ifdef TOKEN_SCANNER_X86
+template <char... Characters>
+inline uint64_t characterMaskSse2(const char *block) {
+    uint64_t mask = 0;
+    for (int lane = 0; lane < 4; ++lane) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(block + lane * 16));
+        __m128i isDelimiter = _mm_setzero_si128();
+        ((isDelimiter = _mm_or_si128(isDelimiter, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(Characters)))), ...);
+        mask |= (uint64_t)(uint32_t)_mm_movemask_epi8(isDelimiter) << (lane * 16);
+    }
+    return mask;
+}
+
+template <char... Characters>
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((target("avx2")))
+#endif
+inline uint64_t characterMaskAvx2(const char *block) {
+    uint64_t mask = 0;
+    for (int lane = 0; lane < 2; ++lane) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i *)(block + lane * 32));
+        __m256i isDelimiter = _mm256_setzero_si256();
+        ((isDelimiter = _mm256_or_si256(isDelimiter, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(Characters)))), ...);
+        mask |= (uint64_t)(uint32_t)_mm256_movemask_epi8(isDelimiter) << (lane * 32);
+    }
+    return mask;
+}
+#endif // TOKEN_SCANNER_X86
+
+#ifdef TOKEN_SCANNER_NEON
+template <char... Characters>
+inline uint64_t characterMaskNeon(const char *block) {
+    static const uint8_t bitValues[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    const uint8x16_t bits = vld1q_u8(bitValues);
+    uint8x16_t laneBits[4];
+    for (int lane = 0; lane < 4; ++lane) {
+        uint8x16_t bytes = vld1q_u8((const uint8_t *)block + lane * 16);
+        uint8x16_t isDelimiter = vdupq_n_u8(0);
+        ((isDelimiter = vorrq_u8(isDelimiter, vceqq_u8(bytes, vdupq_n_u8((uint8_t)Characters)))), ...);
+        laneBits[lane] = vandq_u8(isDelimiter, bits);
+    }
+    uint8x16_t sum = vpaddq_u8(vpaddq_u8(laneBits[0], laneBits[1]), vpaddq_u8(laneBits[2], laneBits[3]));
+    sum = vpaddq_u8(sum, sum);
+    return vgetq_lane_u64(vreinterpretq_u64_u8(sum), 0);
+}
+#endif // TOKEN_SCANNER_NEON
+
+// Delimiter policies
+// A policy says which bytes separate tokens: isDelimiter() checks one byte against its
+// constexpr table and selectMask() returns its kernel for 64-byte blocks
+
+// Whitespace as `isspace` reports it in the C locale (the default)
+struct WhitespaceDelimiters {
+    static bool isDelimiter(char aChar) { return WHITESPACE_TABLE.isDelimiter[(unsigned char)aChar]; }
+    static DelimiterMaskFunction selectMask() { return selectWhitespaceMask(); }
+};
+
+// Exactly the listed characters
+template <char... Characters>
+struct CharacterDelimiters {
+    static constexpr DelimiterTable table = delimiterTableOf<Characters...>();
+
+    static bool isDelimiter(char aChar) { return table.isDelimiter[(unsigned char)aChar]; }
+
+    static DelimiterMaskFunction selectMask() {
+#if defined(TOKEN_SCANNER_X86)
+        static const DelimiterMaskFunction selected =
+            cpuSupportsAvx2() ? characterMaskAvx2<Characters...> : characterMaskSse2<Characters...>;
+        return selected;
+#elif defined(TOKEN_SCANNER_NEON)
+        return characterMaskNeon<Characters...>;
+#else
+        return delimiterMaskScalar<CharacterDelimiters>;
+#endif
+    }
+};
+
+// Comma-separated fields, one record per line (quotes are not parsed, so a quoted comma splits)
+typedef CharacterDelimiters<',', '\n', '\r'> CsvDelimiters;
+
+// Log fields separated by '|', one record per line
+typedef CharacterDelimiters<'|', '\n', '\r'> PipeDelimiters;
+
+// Delimiter sets that can be chosen at runtime (project5 --delimiters)
+enum class TokenDelimiters { Whitespace, Csv, Pipe };
+
+// Calls function(policy) with a value of the selected policy type, so the caller's loop is
+// compiled once for every delimiter set
+template <typename Function>
+inline void withDelimiters(TokenDelimiters delimiters, Function &&function) {
+    switch (delimiters) {
+    case TokenDelimiters::Csv:
+        function(CsvDelimiters());
+        break;
+    case TokenDelimiters::Pipe:
+        function(PipeDelimiters());
+        break;
+    default:
+        function(WhitespaceDelimiters());
+        break;
+    }
+}
+
+// Lookup table of a runtime delimiter set, for byte-at-a-time checks outside the scanners
+inline const DelimiterTable &delimiterTable(TokenDelimiters delimiters) {
+    switch (delimiters) {
+    case TokenDelimiters::Csv:
+        return CsvDelimiters::table;
+    case TokenDelimiters::Pipe:
+        return PipeDelimiters::table;
+    default:
+        return WHITESPACE_TABLE;
+    }
+}
+
+// A token as [start, end) byte offsets into the scanned buffer
+struct TokenSpan {
+    size_t start;
+    size_t end;
+};
+
+// Block-based token boundary finder over one contiguous buffer
+// Each call to next() fills up to `capacity` spans in input order and returns how many were
+// written; it returns 0 once the whole buffer has been scanned. A token that runs up to the
+// end of the buffer is reported with end == length.
+template <typename Delimiters>
+class BasicTokenBoundaryScanner {
+public:
+    BasicTokenBoundaryScanner(const char *data, size_t length)
+        : data(data), length(length), delimiterMask(Delimiters::selectMask()) {}
+
+    size_t next(TokenSpan *spans, size_t capacity) {
+        size_t count = 0;
+        while (count < capacity) {
+            if (transitions == 0) { // Current block fully consumed, classify the next one
+                if (blockStart >= length) {
+                    if (inToken) { // The last token ends at the end of the buffer
+                        spans[count++] = {tokenStart, length};
+                        inToken = false;
+                    }
+                    break;
+                }
+                loadBlock();
+                continue;
+            }
+            // Each set bit is the first byte of a token or the first whitespace after one
+            size_t offset = blockStart - SCAN_BLOCK_SIZE + countTrailingZeros(transitions);
+            transitions &= transitions - 1;
+            if (!inToken) {
+                tokenStart = offset;
+                inToken = true;
+            } else {
+                spans[count++] = {tokenStart, offset};
+                inToken = false;
+            }
+        }
+        return count;
+    }
+
+private:
+    // Classifies the next block and records its token/delimiter transitions
+    void loadBlock() {
+        uint64_t spaceMask;
+        if (length - blockStart >= SCAN_BLOCK_SIZE) {
+            spaceMask = delimiterMask(data + blockStart);
+        } else { // Copy the final partial block and count the bytes past the end as delimiters
+            char tail[SCAN_BLOCK_SIZE];
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, data + blockStart, length - blockStart);
+            spaceMask = delimiterMask(tail) | (~0ULL << (length - blockStart));
+        }
+        uint64_t tokenMask = ~spaceMask;
+        transitions = tokenMask ^ ((tokenMask << 1) | previousTokenBit);
+        previousTokenBit = tokenMask >> 63;
+        blockStart += SCAN_BLOCK_SIZE;
+    }
+
+    static int countTrailingZeros(uint64_t value) {
+#if defined(_MSC_VER) && !defined(__clang__)
+        unsigned long index;
+        _BitScanForward64(&index, value);
+        return (int)index;
+#else
+        return __builtin_ctzll(value);
+#endif
+    }
+
+    const char *data;
+    size_t length;
+    DelimiterMaskFunction delimiterMask;
+    size_t blockStart = 0;         // Offset of the block after the one being consumed
+    uint64_t transitions = 0;      // Unconsumed boundaries of the current block
+    uint64_t previousTokenBit = 0; // 1 if the last byte of the previous block was inside a token
+    bool inToken = false;
+    size_t tokenStart = 0;
+};
+
+typedef BasicTokenBoundaryScanner<WhitespaceDelimiters> TokenBoundaryScanner;
+
+// Number of spans fetched from the boundary scanner per batch
+const size_t SPAN_BATCH_SIZE = 256;
+
+// Calls onToken for every maximal run of non-delimiter characters in the buffer
+template <typename Delimiters = WhitespaceDelimiters, typename TokenCallback>
+inline void forEachToken(const char *data, size_t length, TokenCallback &&onToken) {
+    BasicTokenBoundaryScanner<Delimiters> scanner(data, length);
+    TokenSpan spans[SPAN_BATCH_SIZE];
+    size_t count;
+    while ((count = scanner.next(spans, SPAN_BATCH_SIZE)) > 0) {
+        for (size_t i = 0; i < count; ++i) {
+            onToken(std::string_view(data + spans[i].start, spans[i].end - spans[i].start));
+        }
+    }
+}
+
+// Same with a delimiter set chosen at runtime
+template <typename TokenCallback>
+inline void forEachToken(TokenDelimiters delimiters, const char *data, size_t length, TokenCallback &&onToken) {
+    withDelimiters(delimiters, [&](auto policy) { forEachToken<decltype(policy)>(data, length, onToken); });
+}
+
+// Chunked tokenizer for inputs that are read piece by piece
+// Tokens entirely inside a chunk are passed as views into that chunk; a token that runs up to
+// the end of a chunk is carried over and passed as a view into the carry buffer once it ends.
+class StreamTokenizer {
+public:
+    explicit StreamTokenizer(TokenDelimiters delimiters = TokenDelimiters::Whitespace) : delimiters(delimiters) {}
+
+    template <typename TokenCallback>
+    void feed(const char *data, size_t length, TokenCallback &&onToken) {
+        withDelimiters(delimiters, [&](auto policy) { feedWith<decltype(policy)>(data, length, onToken); });
+    }
+
+    // Passes the final token if the input did not end with a delimiter
+    template <typename TokenCallback>
+    void finish(TokenCallback &&onToken) {
+        if (!carry.empty()) {
+            onToken(std::string_view(carry));
+            carry.clear();
+        }
+    }
+
+private:
+    template <typename Delimiters, typename TokenCallback>
+    void feedWith(const char *data, size_t length, TokenCallback &onToken) {
+        size_t i = 0;
+        if (!carry.empty()) { // Finish the token left over from the previous chunk
+            while (i < length && !Delimiters::isDelimiter(data[i])) {
+                ++i;
+            }
+            carry.append(data, i);
+            if (i == length) {
+                return;
+            }
+            onToken(std::string_view(carry));
+            carry.clear();
+        }
+        BasicTokenBoundaryScanner<Delimiters> scanner(data + i, length - i);
+        TokenSpan spans[SPAN_BATCH_SIZE];
+        size_t count;
+        while ((count = scanner.next(spans, SPAN_BATCH_SIZE)) > 0) {
+            for (size_t s = 0; s < count; ++s) {
+                const char *start = data + i + spans[s].start;
+                size_t tokenLength = spans[s].end - spans[s].start;
+                if (i + spans[s].end == length) {
+                    carry.assign(start, tokenLength); // May continue in the next chunk
+                } else {
+                    onToken(std::string_view(start, tokenLength));
+                }
+            }
+        }
+    }
+
+    std::string carry; // Token that reached the end of the last chunk
+    TokenDelimiters delimiters;
+};
+
+#endif // TOKEN_SCANNER_H
@@ -0,0 +1,285 @@
+/*
+ * File Name: token_table.h
+ * 
+ * Description:
+ * Shared token interning and ranking helpers used by both the encoder (project5.cpp) and the
+ * encoder/decoder (project5_decompress.cpp).
+ * 
+ * Every distinct token is interned exactly once into a dense provisional id (0, 1, 2, ... in
+ * order of first appearance) and its frequency is tracked per id. After counting, the ids are
+ * sorted by frequency (descending) and lexicographically for ties, and a flat remap array turns
+ * each provisional id into its 1-based position in that order. This means tokens are hashed and
+ * compared once per occurrence, and encoding is a plain array lookup per token.
+ * 
+ * Tokens are keyed as std::string_view. intern() keeps the caller's view, so the buffer the
+ * token lives in (a mapped file or the buffered input) must outlive the table; internCopy()
+ * copies new tokens into the table's TokenArena (token_arena.h) for inputs read through a
+ * reusable chunk, so the bytes of each distinct token are stored exactly once either way.
+ * The token -> id index is a FlatTokenMap (flat_token_map.h) whose slots hold ids into idTokens,
+ * and each token is hashed once per call.
+ *
+ * The ranking sort avoids string compares where it can. Most tokens occur once or twice, so ids
+ * are first bucketed by frequency with a counting pass (only the few tokens with a frequency of
+ * RANK_BUCKET_LIMIT or more go through the full comparator). Each bucket is then sorted on a
+ * cached 8-byte big-endian prefix of the token, falling back to a string compare only when two
+ * prefixes are equal. Buckets are independent, so they are sorted on several threads when asked.
+ * The result is exactly the order of RankOrder.
+ */
+
+#ifndef TOKEN_TABLE_H
+#define TOKEN_TABLE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "flat_token_map.h"
+#include "memory_placement.h"
+#include "token_arena.h"
+
+// Intern table mapping each distinct token to a dense provisional id
+struct TokenTable {
+    FlatTokenMap tokenIds;                  // Token -> provisional id
+    LargeVector<std::string_view> idTokens; // Provisional id -> token
+    LargeVector<int> idFrequency;           // Provisional id -> frequency
+    TokenArena arena;                       // Bytes of tokens copied by internCopy
+
+    // Returns the provisional id of the token, assigning the next id if it is new,
+    // and increments the token's frequency. The view must outlive the table.
+    int intern(std::string_view token) { return merge(token, 1); }
+
+    // Same as intern, but copies a new token into the table's arena first
+    int internCopy(std::string_view token) {
+        uint64_t hash = hashToken(token);
+        int id = tokenIds.find(token, hash, idTokens);
+        if (id < 0) {
+            return add(arena.store(token), hash, 1);
+        }
+        idFrequency[id]++;
+        return id;
+    }
+
+    // Adds `count` occurrences of a token counted elsewhere (used to merge per-thread tables)
+    // and returns its provisional id. The view must outlive the table.
+    int merge(std::string_view token, int count) { return add(token, hashToken(token), count); }
+
+    // Returns the provisional id of the token, or -1 if it has not been interned
+    int find(std::string_view token) const { return tokenIds.find(token, hashToken(token), idTokens); }
+
+    size_t size() const { return idTokens.size(); }
+
+    std::string_view token(int id) const { return idTokens[id]; }
+
+    // Forgets every token but keeps the allocated capacity, so the table can be reused
+    void clear() {
+        tokenIds.clear();
+        idTokens.clear();
+        idFrequency.clear();
+        arena.reset();
+    }
+
+private:
+    int add(std::string_view token, uint64_t hash, int count) {
+        auto result = tokenIds.findOrInsert(token, hash, (int)idTokens.size(), idTokens);
+        if (result.second) {
+            idTokens.push_back(token);
+            idFrequency.push_back(0);
+        }
+        idFrequency[result.first] += count;
+        return result.first;
+    }
+};
+
+// Ranking order of provisional ids: frequency (descending), then lexicographic for ties
+struct RankOrder {
+    const TokenTable &table;
+
+    bool operator()(int a, int b) const {
+        if (table.idFrequency[a] != table.idFrequency[b]) {
+            return table.idFrequency[a] > table.idFrequency[b]; // Sort by frequency (descending)
+        }
+        return table.token(a) < table.token(b); // Lexicographical order for tie-breaking
+    }
+};
+
+// Tokens at least this frequent are ranked with RankOrder; less frequent ones are bucketed
+const int RANK_BUCKET_LIMIT = 1 << 16;
+
+// Buckets of at least this many tokens are split across threads when sorting in parallel
+const size_t PARALLEL_BUCKET_SIZE = 1 << 15;
+
+// Sort key of a token within a bucket of tokens with equal frequency
+struct PrefixKey {
+    uint64_t prefix; // First 8 bytes, big-endian and zero padded, so integer order is byte order
+    int id;
+};
+
+// Returns the first 8 bytes of the token as a big-endian integer, zero padded
+inline uint64_t tokenPrefix(std::string_view token) {
+    uint64_t prefix = 0;
+    size_t length = std::min<size_t>(8, token.size());
+    for (size_t i = 0; i < length; ++i) {
+        prefix |= (uint64_t)(uint8_t)token[i] << (56 - 8 * i);
+    }
+    return prefix;
+}
+
+// Lexicographic token order on prefix keys; the strings are compared only on equal prefixes
+struct PrefixOrder {
+    const TokenTable &table;
+
+    bool operator()(const PrefixKey &a, const PrefixKey &b) const {
+        if (a.prefix != b.prefix) {
+            return a.prefix < b.prefix;
+        }
+        return table.token(a.id) < table.token(b.id);
+    }
+};
+
+// Sorts the provisional ids by frequency (descending) and lexicographically for ties
+// With threadCount > 1 the frequency buckets are sorted in parallel; the order is the same
+inline std::vector<int> sortTokenIds(const TokenTable &table, size_t threadCount = 1) {
+    // Counting pass: bucket sizes by frequency, and the rare tokens too frequent to bucket
+    std::vector<int> sortedIds;
+    sortedIds.reserve(table.size());
+    int bucketCount = 1;
+    for (size_t id = 0; id < table.size(); ++id) {
+        if (table.idFrequency[id] >= RANK_BUCKET_LIMIT) {
+            sortedIds.push_back((int)id);
+        } else {
+            bucketCount = std::max(bucketCount, table.idFrequency[id] + 1);
+        }
+    }
+    std::sort(sortedIds.begin(), sortedIds.end(), RankOrder{table});
+    size_t frequentCount = sortedIds.size();
+
+    // Place the remaining ids into their buckets, highest frequency first
+    std::vector<size_t> bucketStart(bucketCount + 1, 0); // Start of the bucket for frequency f
+    for (size_t id = 0; id < table.size(); ++id) {
+        if (table.idFrequency[id] < RANK_BUCKET_LIMIT) {
+            bucketStart[table.idFrequency[id]]++;
+        }
+    }
+    size_t offset = 0;
+    for (int frequency = bucketCount - 1; frequency >= 0; --frequency) {
+        size_t size = bucketStart[frequency];
+        bucketStart[frequency] = offset;
+        offset += size;
+    }
+    bucketStart[bucketCount] = offset;
+    std::vector<PrefixKey> keys(offset);
+    std::vector<size_t> fill(bucketStart.begin(), bucketStart.end() - 1);
+    for (size_t id = 0; id < table.size(); ++id) {
+        int frequency = table.idFrequency[id];
+        if (frequency < RANK_BUCKET_LIMIT) {
+            keys[fill[frequency]++] = {tokenPrefix(table.token((int)id)), (int)id};
+        }
+    }
+
+    // Sort every bucket; bucket f spans [bucketStart[f], bucketStart[f] + size) in keys
+    std::vector<std::pair<size_t, size_t>> ranges;
+    for (int frequency = bucketCount - 1; frequency >= 0; --frequency) {
+        size_t begin = bucketStart[frequency];
+        size_t end = frequency > 0 ? bucketStart[frequency - 1] : offset;
+        if (end - begin > 1) {
+            ranges.push_back({begin, end});
+        }
+    }
+    PrefixOrder order{table};
+    if (threadCount <= 1) {
+        for (const auto &range : ranges) {
+            std::sort(keys.begin() + range.first, keys.begin() + range.second, order);
+        }
+    } else {
+        // Large buckets are cut into one piece per thread; each thread sorts its pieces and its
+        // share of the small buckets, then the pieces of each large bucket are merged pairwise
+        std::vector<std::vector<std::pair<size_t, size_t>>> work(threadCount);
+        std::vector<std::vector<size_t>> pieceBounds; // Piece boundaries of each large bucket
+        size_t nextThread = 0;
+        for (const auto &range : ranges) {
+            size_t size = range.second - range.first;
+            if (size < PARALLEL_BUCKET_SIZE) {
+                work[nextThread++ % threadCount].push_back(range);
+                continue;
+            }
+            std::vector<size_t> bounds;
+            for (size_t piece = 0; piece <= threadCount; ++piece) {
+                bounds.push_back(range.first + size * piece / threadCount);
+            }
+            for (size_t piece = 0; piece < threadCount; ++piece) {
+                work[piece].push_back({bounds[piece], bounds[piece + 1]});
+            }
+            pieceBounds.push_back(bounds);
+        }
+        auto runOnThreads = [threadCount](auto task) {
+            std::vector<std::thread> workers;
+            for (size_t t = 1; t < threadCount; ++t) {
+                workers.emplace_back(task, t);
+            }
+            task(0);
+            for (std::thread &worker : workers) {
+                worker.join();
+            }
+        };
+        runOnThreads([&](size_t t) {
+            for (const auto &range : work[t]) {
+                std::sort(keys.begin() + range.first, keys.begin() + range.second, order);
+            }
+        });
+        for (std::vector<size_t> &bounds : pieceBounds) {
+            while (bounds.size() > 2) { // Each round merges neighbouring pieces in parallel
+                size_t mergeCount = (bounds.size() - 1) / 2;
+                runOnThreads([&](size_t t) {
+                    for (size_t m = t; m < mergeCount; m += threadCount) {
+                        std::inplace_merge(keys.begin() + bounds[2 * m], keys.begin() + bounds[2 * m + 1],
+                                           keys.begin() + bounds[2 * m + 2], order);
+                    }
+                });
+                std::vector<size_t> merged;
+                for (size_t b = 0; b < bounds.size(); b += 2) {
+                    merged.push_back(bounds[b]);
+                }
+                if (merged.back() != bounds.back()) {
+                    merged.push_back(bounds.back());
+                }
+                bounds.swap(merged);
+            }
+        }
+    }
+
+    sortedIds.resize(frequentCount + keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        sortedIds[frequentCount + i] = keys[i].id;
+    }
+    return sortedIds;
+}
+
+// Returns the first `k` ids of sortTokenIds(table) without sorting the rest
+// nth_element moves the top k to the front in linear time, so only those k are sorted
+inline std::vector<int> sortTopTokenIds(const TokenTable &table, size_t k) {
+    std::vector<int> sortedIds(table.size());
+    for (size_t id = 0; id < sortedIds.size(); ++id) {
+        sortedIds[id] = (int)id;
+    }
+    if (k < sortedIds.size()) {
+        std::nth_element(sortedIds.begin(), sortedIds.begin() + k, sortedIds.end(), RankOrder{table});
+        sortedIds.resize(k);
+    }
+    std::sort(sortedIds.begin(), sortedIds.end(), RankOrder{table});
+    return sortedIds;
+}
+
+// Builds the flat remap array from provisional id to 1-based position in the sorted order
+// `idCount` is the number of provisional ids; ids missing from sortedIds map to 0
+inline std::vector<int> buildPositionMap(const std::vector<int> &sortedIds, size_t idCount = 0) {
+    std::vector<int> idPosition(std::max(idCount, sortedIds.size()), 0);
+    for (size_t i = 0; i < sortedIds.size(); ++i) {
+        idPosition[sortedIds[i]] = (int)i + 1; // Positions start at 1
+    }
+    return idPosition;
+}
+
+#endif // TOKEN_TABLE_H
@@ -0,0 +1,91 @@
+/*
+ * File Name: work_pool.h
+ *
+ * Description:
+ * Work-stealing scheduler for batches of independent tasks of uneven size (for example one
+ * input file each). Task indices are dealt out to one queue per worker in contiguous runs. A
+ * worker takes tasks from the front of its own queue and, once that is empty, steals from the
+ * back of another worker's queue, so a few large tasks do not leave the other threads idle.
+ *
+ * Every task is told which worker runs it, so callers can keep per-worker state (tables,
+ * arenas, buffers) and reuse it across the tasks that worker runs without any locking.
+ */
+
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Tasks waiting for one worker
+struct WorkQueue {
+    std::mutex lock;
+    std::deque<size_t> indices;
+
+    bool takeFront(size_t &index) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (indices.empty()) {
+            return false;
+        }
+        index = indices.front();
+        indices.pop_front();
+        return true;
+    }
+
+    bool takeBack(size_t &index) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (indices.empty()) {
+            return false;
+        }
+        index = indices.back();
+        indices.pop_back();
+        return true;
+    }
+};
+
+// Returns the number of workers runWorkStealing starts for these arguments
+inline size_t workerCountFor(size_t taskCount, size_t workerCount) {
+    return std::max<size_t>(1, std::min(workerCount, taskCount));
+}
+
+// Runs task(worker, index) for every index in [0, taskCount) on up to workerCount threads
+// (worker 0 is the calling thread). Returns once every task has finished.
+template <typename Task>
+inline void runWorkStealing(size_t taskCount, size_t workerCount, Task task) {
+    workerCount = workerCountFor(taskCount, workerCount);
+    std::vector<WorkQueue> queues(workerCount);
+    for (size_t index = 0; index < taskCount; ++index) {
+        queues[index * workerCount / taskCount].indices.push_back(index);
+    }
+    auto work = [&](size_t worker) {
+        size_t index;
+        for (;;) {
+            if (queues[worker].takeFront(index)) {
+                task(worker, index);
+                continue;
+            }
+            bool stole = false; // No tasks are added later, so empty queues everywhere means done
+            for (size_t step = 1; step < workerCount && !stole; ++step) {
+                stole = queues[(worker + step) % workerCount].takeBack(index);
+            }
+            if (!stole) {
+                return;
+            }
+            task(worker, index);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t worker = 1; worker < workerCount; ++worker) {
+        workers.emplace_back(work, worker);
+    }
+    work(0);
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+#endif // WORK_POOL_H